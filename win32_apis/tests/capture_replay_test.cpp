@@ -0,0 +1,307 @@
+﻿#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "bin_rasterizer.hpp"
+#include "cpu_dispatch.hpp"
+#include "entity_store.hpp"
+#include "frame_capture.hpp"
+#include "frame_replay.hpp"
+#include "job_system.hpp"
+#include "mesh.hpp"
+#include "point_cloud.hpp"
+#include "renderer.hpp"
+#include "render_view.hpp"
+#include "text_renderer.hpp"
+#include "test_common.hpp"
+
+// Records a few frames that use every captured draw path, then replays the capture on every CPU path
+// and back buffer format. FrameReplayer compares each presented image with the recorded hash, so a
+// replay passes only if it reproduces every frame bit for bit. A damaged hash or a damaged record must
+// be caught, never crash the replayer
+
+#define TEST_WIDTH 320
+#define TEST_HEIGHT 200
+#define TEST_FRAMES 6
+
+namespace
+{
+	std::vector<uint8_t> ReadFile(const std::string& path)
+	{
+		std::ifstream stream(path, std::ios::binary);
+		return std::vector<uint8_t>((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+	{
+		std::ofstream stream(path, std::ios::binary);
+		stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	}
+
+	void DrawFrame(Renderer& renderer, BinRasterizer& binner, TextRenderer& text, EntityStore& entities,
+		std::vector<RenderView>& views, const Mesh& mesh, int frame)
+	{
+		JobSystem& jobs = JobSystem::GetInstance();
+
+		entities.Integrate(jobs, 0.016f);
+		for (size_t i = 0; i < views.size(); ++i)
+			views[i].camera.position = vec3_t(0.3f * i + 0.05f * frame, 0.0f, -5.0f);
+		entities.ProjectViews(jobs, views.data(), views.size(), 8.0f);
+
+		// Binned scene per view
+		binner.Begin(renderer);
+		for (const RenderView& view : views)
+		{
+			binner.SetViewport(view.viewport);
+			binner.ClearColorBuffer(0xFF020202);
+			binner.DrawGrid(0xFF333333, 16);
+
+			const std::vector<vec2_t>& points = view.projection.GetProjectedPoints();
+			for (size_t i = 0; i < points.size(); ++i)
+			{
+				if (view.visible_chunks[i / ENTITY_CHUNK_SIZE])
+					binner.DrawRectangle(static_cast<int>(points[i].x) + view.viewport.x + view.viewport.width / 2,
+						static_cast<int>(points[i].y) + view.viewport.y + view.viewport.height / 2, 3, 3, 0xFF57A649);
+			}
+
+			binner.DrawTriangle(vec2_t(view.viewport.x + 10.0f, view.viewport.y + 150.0f), vec2_t(view.viewport.x + 80.0f, view.viewport.y + 120.0f),
+				vec2_t(view.viewport.x + 40.0f + frame, view.viewport.y + 190.0f), 0x80D04040);
+		}
+		binner.Flush(jobs);
+
+		// Immediate paths on top
+		const float t = frame * 0.3f;
+		renderer.DrawLine(5, 5, 300, 190 - frame * 10, 0xFFFFFFFF);
+		renderer.DrawLineAA(vec2_t(-20.0f, 40.0f + frame), vec2_t(400.0f, 10.0f * frame), 0xC0FFE080);
+
+		vec2_t polygon[7];
+		for (int i = 0; i < 7; ++i)
+			polygon[i] = vec2_t(160.0f + 60.0f * std::cos(t + i * 0.8976f), 100.0f + 60.0f * std::sin(t + i * 0.8976f));
+		renderer.DrawConvexPolygon(polygon, 7, 0x6040A0FF);
+		renderer.DrawPolyline(polygon, 7, 0xFFFFFF00, true);
+
+		renderer.FillRect<BlendMode::Alpha>(200 + frame, 20, 60, 30, 0x80FF00FF);
+		renderer.FillSpan<BlendMode::Opaque>(0, 199, 320, 0xFF00FF00);
+		renderer.DrawPixel<BlendMode::Opaque>(1, 1, 0xFFFF0000);
+
+		const RenderView& first = views[0];
+		std::vector<vec3_t> camera_space(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); ++i)
+			camera_space[i] = vec3_t(mesh.vertices[i].x - first.camera.position.x, mesh.vertices[i].y, mesh.vertices[i].z - first.camera.position.z);
+		renderer.DrawWireframe3D(first.projection, first.viewport, camera_space.data(), camera_space.size(), mesh.edges.data(), mesh.edges.size(), 0xFF4A90D9);
+		renderer.DrawTriangle3D(views[1].projection, views[1].viewport, camera_space.data(), 0x803A6EA5);
+
+		char label[32];
+		std::snprintf(label, sizeof(label), "FRAME %d", frame);
+		text.DrawString(renderer, 8, 8, label, 0xC0E0E0E0);
+	}
+
+	// Records TEST_FRAMES frames, the third one skipped
+	bool RecordCapture(const std::string& path, PixelFormat format, FramebufferLayout layout)
+	{
+		std::vector<uint32_t> front(TEST_WIDTH * TEST_HEIGHT);
+		Renderer renderer;
+		renderer.Initialize(front.data(), TEST_WIDTH, TEST_HEIGHT, format, layout);
+
+		FrameCapture capture;
+		if (!capture.Open(path, TEST_WIDTH, TEST_HEIGHT, format, layout))
+			return false;
+		FrameCapture::SetActive(&capture);
+
+		BinRasterizer binner;
+		TextRenderer text;
+		text.Initialize(12);
+
+		EntityStore entities;
+		for (int i = 0; i < 3000; ++i)
+			entities.Create(vec3_t(std::fmod(i * 0.37f, 4.0f) - 2.0f, std::fmod(i * 0.61f, 3.0f) - 1.5f, std::fmod(i * 0.13f, 2.0f)),
+				i % 3 == 0 ? vec3_t(0.1f, 0.0f, 0.0f) : vec3_t());
+
+		std::vector<Viewport> viewports;
+		LayoutViewGrid(TEST_WIDTH, TEST_HEIGHT, 2, 1, viewports);
+		std::vector<RenderView> views(viewports.size());
+		for (size_t i = 0; i < views.size(); ++i)
+		{
+			views[i].viewport = viewports[i];
+			views[i].camera.fov_factor = 300.0f;
+			views[i].projection.SetFOVFactors(300.0f);
+		}
+
+		const Mesh mesh = BuildGridMesh(4, 4, -3.0f, 3.0f, -2.0f, 6.0f, 1.0f);
+
+		// Projected but not drawn: records quantized chunks, so the replay runs ProjectQuantizedRange too
+		std::vector<float> cloud_xs(5000), cloud_ys(5000), cloud_zs(5000);
+		for (size_t i = 0; i < cloud_xs.size(); ++i)
+		{
+			cloud_xs[i] = std::fmod(i * 0.29f, 3.0f) - 1.5f;
+			cloud_ys[i] = std::fmod(i * 0.53f, 2.0f) - 1.0f;
+			cloud_zs[i] = std::fmod(i * 0.17f, 4.0f);
+		}
+		PointCloud cloud;
+		cloud.Build(cloud_xs.data(), cloud_ys.data(), cloud_zs.data(), cloud_xs.size());
+		std::vector<RenderView> cloud_views(1);
+		cloud_views[0].viewport = viewports[0];
+		cloud_views[0].camera.fov_factor = 300.0f;
+
+		for (int frame = 0; frame < TEST_FRAMES; ++frame)
+		{
+			capture.Record(CaptureRecord::FrameBegin, static_cast<uint32_t>(frame), static_cast<int32_t>(16));
+			if (frame == 2)
+			{
+				renderer.SkipFrame();
+			}
+			else
+			{
+				cloud_views[0].camera.position = vec3_t(0.0f, 0.1f * frame, -5.0f);
+				cloud.ProjectViews(JobSystem::GetInstance(), cloud_views.data(), cloud_views.size(), 8.0f);
+				DrawFrame(renderer, binner, text, entities, views, mesh, frame);
+			}
+			renderer.SwapBuffers();
+		}
+
+		FrameCapture::SetActive(nullptr);
+		capture.Close();
+		renderer.Shutdown();
+		return true;
+	}
+
+	// One hand-made frame: a black clear, the records written by record, then the Present of a black image
+	template<typename Fn>
+	bool ReplayHandMade(const std::string& path, Fn&& record)
+	{
+		FrameCapture capture;
+		if (!capture.Open(path, TEST_WIDTH, TEST_HEIGHT, PixelFormat::ARGB8888, FramebufferLayout::Linear))
+			return false;
+
+		capture.Record(CaptureRecord::FrameBegin, static_cast<uint32_t>(0), static_cast<int32_t>(16));
+		capture.Record(CaptureRecord::Clear, static_cast<uint32_t>(0xFF000000));
+		record(capture);
+
+		const std::vector<uint32_t> black(TEST_WIDTH * TEST_HEIGHT, 0xFF000000);
+		capture.Present(true, black.data(), black.size());
+		capture.Close();
+
+		FrameReplayer replayer;
+		return replayer.Run(path);
+	}
+
+	void CheckDamagedRecords(const std::string& path)
+	{
+		const uint8_t opaque = static_cast<uint8_t>(BlendMode::Opaque);
+		const uint8_t unclipped = static_cast<uint8_t>(ClipMode::None);
+
+		// Marked unclipped, far below the frame: replay clips anyway, so nothing is drawn
+		CHECK(ReplayHandMade(path, [&](FrameCapture& capture)
+		{
+			capture.Record(CaptureRecord::TypedSpan, opaque, unclipped, static_cast<int32_t>(0), static_cast<int32_t>(5000000),
+				static_cast<int32_t>(100), static_cast<uint32_t>(0xFFFFFFFF));
+		}));
+
+		// A glyph rect that reads far past the 4 byte mask recorded with it
+		CHECK(!ReplayHandMade(path, [&](FrameCapture& capture)
+		{
+			AlphaMaskRect rect = {};
+			rect.src_y = 60000;
+			rect.width = 2;
+			rect.height = 2;
+			const uint8_t mask[4] = { 255, 255, 255, 255 };
+			capture.Record(CaptureRecord::AlphaMasks, static_cast<int32_t>(10), static_cast<int32_t>(10), static_cast<uint32_t>(0xFFFFFFFF),
+				static_cast<int32_t>(4096), MakeCaptureSpan(&rect, 1), MakeCaptureSpan(mask, 4));
+		}));
+
+		// Counts near 4G must fail the record, not allocate
+		const float position[1] = { 1.0f };
+		CHECK(!ReplayHandMade(path, [&](FrameCapture& capture)
+		{
+			capture.Record(CaptureRecord::Positions, static_cast<uint32_t>(0xFFFFFFF0),
+				MakeCaptureSpan(position, 1), MakeCaptureSpan(position, 1), MakeCaptureSpan(position, 1));
+		}));
+
+		const uint32_t chunk = 0;
+		CHECK(!ReplayHandMade(path, [&](FrameCapture& capture)
+		{
+			capture.Record(CaptureRecord::Positions, static_cast<uint32_t>(0),
+				MakeCaptureSpan(position, 1), MakeCaptureSpan(position, 1), MakeCaptureSpan(position, 1));
+			capture.Record(CaptureRecord::Project, static_cast<uint32_t>(0), vec3_t(), 300.0f, static_cast<uint32_t>(0xFFFFFFF0),
+				MakeCaptureSpan(&chunk, 1));
+		}));
+
+		// Quantized positions that do not start a chunk
+		const uint16_t quantized[1] = { 7 };
+		CHECK(!ReplayHandMade(path, [&](FrameCapture& capture)
+		{
+			capture.Record(CaptureRecord::QuantizedPositions, static_cast<uint32_t>(5), vec3_t(), vec3_t(0.01f, 0.01f, 0.01f),
+				MakeCaptureSpan(quantized, 1), MakeCaptureSpan(quantized, 1), MakeCaptureSpan(quantized, 1));
+		}));
+
+		// A chunk projected without its positions
+		CHECK(!ReplayHandMade(path, [&](FrameCapture& capture)
+		{
+			capture.Record(CaptureRecord::Project, static_cast<uint32_t>(0), vec3_t(), 300.0f, static_cast<uint32_t>(100),
+				MakeCaptureSpan(&chunk, 1));
+		}));
+	}
+}
+
+int main()
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "capture_replay_test.cap").string();
+	const CpuPath detected = DetectCpuPath();
+
+	const struct { PixelFormat format; FramebufferLayout layout; } targets[] = {
+		{ PixelFormat::ARGB8888, FramebufferLayout::Linear },
+		{ PixelFormat::ARGB8888, FramebufferLayout::Tiled },
+		{ PixelFormat::RGB565, FramebufferLayout::Linear },
+		{ PixelFormat::Indexed8, FramebufferLayout::Tiled }
+	};
+
+	for (const auto& target : targets)
+	{
+		// Recorded on the best path, replayed on every path: all of them must draw the same pixels
+		CHECK(SelectCpuPath(detected));
+		CHECK(RecordCapture(path, target.format, target.layout));
+
+		for (CpuPath cpu : { CpuPath::Scalar, CpuPath::SSE41, CpuPath::AVX2, CpuPath::AVX512 })
+		{
+			if (!IsCpuPathSupported(cpu))
+				continue;
+
+			CHECK(SelectCpuPath(cpu));
+			FrameReplayer replayer;
+			const bool matched = replayer.Run(path);
+			CHECK(matched);
+			if (!matched)
+				std::cerr << "  replay on " << GetCpuPathName(cpu) << " differs, format " << static_cast<int>(target.format)
+					<< " layout " << static_cast<int>(target.layout) << "\n";
+		}
+	}
+	CHECK(SelectCpuPath(detected));
+
+	// The capture ends with the last Present's image hash, a flipped bit there must fail the replay
+	std::vector<uint8_t> data = ReadFile(path);
+	CHECK(data.size() > 8);
+	data.back() ^= 1;
+	WriteFile(path, data);
+	{
+		FrameReplayer replayer;
+		CHECK(!replayer.Run(path));
+	}
+
+	// Cut inside a record
+	data.back() ^= 1;
+	data.resize(data.size() - 5);
+	WriteFile(path, data);
+	{
+		FrameReplayer replayer;
+		CHECK(!replayer.Run(path));
+	}
+
+	CheckDamagedRecords(path);
+
+	std::remove(path.c_str());
+	return TestResult("capture_replay_test");
+}
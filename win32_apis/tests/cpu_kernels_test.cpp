@@ -0,0 +1,144 @@
+﻿#include <cstring>
+#include <random>
+#include <vector>
+
+#include "cpu_dispatch.hpp"
+#include "test_common.hpp"
+
+// Every SIMD path this CPU runs must give bit identical results to the scalar kernels, for every
+// count (vector bodies and tails) and misaligned starts
+
+namespace
+{
+	// Lengths around every vector width, plus a long run
+	const size_t COUNTS[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 1000 };
+
+	// Colors that hit the blend special cases: transparent, opaque, half and random alpha
+	uint32_t RandomColor(std::mt19937& random)
+	{
+		const uint32_t rgb = random() & 0x00FFFFFF;
+		switch (random() % 4)
+		{
+		case 0: return rgb;
+		case 1: return rgb | 0xFF000000;
+		case 2: return rgb | 0x80000000;
+		default: return rgb | (random() << 24);
+		}
+	}
+
+	float RandomFloat(std::mt19937& random, float low, float high)
+	{
+		return std::uniform_real_distribution<float>(low, high)(random);
+	}
+
+	bool SameBits(const void* a, const void* b, size_t size)
+	{
+		return size == 0 || std::memcmp(a, b, size) == 0;
+	}
+
+	void CheckPixelKernels(const CpuKernels& scalar, const CpuKernels& simd, std::mt19937& random)
+	{
+		for (size_t count : COUNTS)
+		{
+			for (size_t offset = 0; offset < 4; ++offset)
+			{
+				std::vector<uint32_t> base(count + offset);
+				std::vector<uint8_t> coverage(count + offset);
+				for (uint32_t& pixel : base)
+					pixel = RandomColor(random);
+				for (uint8_t& value : coverage)
+					value = static_cast<uint8_t>(random() % 3 == 0 ? (random() % 2) * 255 : random());
+
+				const uint32_t color = RandomColor(random);
+
+				std::vector<uint32_t> expected = base, actual = base;
+				scalar.fill(expected.data() + offset, count, color);
+				simd.fill(actual.data() + offset, count, color);
+				CHECK(expected == actual);
+
+				expected = base;
+				actual = base;
+				scalar.blend(expected.data() + offset, count, color);
+				simd.blend(actual.data() + offset, count, color);
+				CHECK(expected == actual);
+
+				expected = base;
+				actual = base;
+				scalar.blend_mask(expected.data() + offset, coverage.data() + offset, count, color);
+				simd.blend_mask(actual.data() + offset, coverage.data() + offset, count, color);
+				CHECK(expected == actual);
+			}
+		}
+	}
+
+	void CheckProjectionKernels(const CpuKernels& scalar, const CpuKernels& simd, std::mt19937& random)
+	{
+		const float near_plane = 0.1f;
+
+		for (size_t count : COUNTS)
+		{
+			// Points in front of, across and behind the near plane
+			std::vector<float> xs(count), ys(count), zs(count);
+			std::vector<uint16_t> qx(count), qy(count), qz(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				xs[i] = RandomFloat(random, -10.0f, 10.0f);
+				ys[i] = RandomFloat(random, -10.0f, 10.0f);
+				zs[i] = RandomFloat(random, -6.0f, 20.0f);
+				qx[i] = static_cast<uint16_t>(random());
+				qy[i] = static_cast<uint16_t>(random());
+				qz[i] = static_cast<uint16_t>(random());
+			}
+
+			const vec3_t camera(RandomFloat(random, -1.0f, 1.0f), RandomFloat(random, -1.0f, 1.0f), RandomFloat(random, -6.0f, -4.0f));
+			const float fov_factor = RandomFloat(random, 100.0f, 2000.0f);
+
+			std::vector<vec2_t> expected(count), actual(count);
+			scalar.project(xs.data(), ys.data(), zs.data(), count, camera, fov_factor, near_plane, expected.data());
+			simd.project(xs.data(), ys.data(), zs.data(), count, camera, fov_factor, near_plane, actual.data());
+			CHECK(SameBits(expected.data(), actual.data(), count * sizeof(vec2_t)));
+
+			const vec3_t origin(RandomFloat(random, -4.0f, 0.0f), RandomFloat(random, -4.0f, 0.0f), RandomFloat(random, -4.0f, 0.0f));
+			const vec3_t step(RandomFloat(random, 0.0f, 0.001f), RandomFloat(random, 0.0f, 0.001f), RandomFloat(random, 0.0f, 0.001f));
+			scalar.project_quantized(qx.data(), qy.data(), qz.data(), count, origin, step, camera, fov_factor, near_plane, expected.data());
+			simd.project_quantized(qx.data(), qy.data(), qz.data(), count, origin, step, camera, fov_factor, near_plane, actual.data());
+			CHECK(SameBits(expected.data(), actual.data(), count * sizeof(vec2_t)));
+		}
+	}
+}
+
+int main()
+{
+	CHECK(SelectCpuPath(CpuPath::Scalar));
+	const CpuKernels scalar = GetCpuKernels();
+	CHECK(scalar.path == CpuPath::Scalar);
+
+	for (CpuPath path : { CpuPath::SSE41, CpuPath::AVX2, CpuPath::AVX512 })
+	{
+		if (!IsCpuPathSupported(path))
+		{
+			std::cout << GetCpuPathName(path) << ": not supported here, skipped\n";
+			continue;
+		}
+
+		CHECK(SelectCpuPath(path));
+		const CpuKernels simd = GetCpuKernels();
+		CHECK(simd.path == path);
+
+		std::mt19937 random(static_cast<uint32_t>(path) + 1);
+		const int failures = TestFailures();
+		CheckPixelKernels(scalar, simd, random);
+		CheckProjectionKernels(scalar, simd, random);
+
+		std::cout << GetCpuPathName(path) << ": " << (TestFailures() == failures ? "matches scalar" : "differs from scalar") << "\n";
+	}
+
+	// Round trip of the names --cpu and RENDERER_CPU_PATH accept
+	for (CpuPath path : { CpuPath::Scalar, CpuPath::SSE41, CpuPath::AVX2, CpuPath::AVX512 })
+	{
+		CpuPath parsed;
+		CHECK(ParseCpuPath(GetCpuPathName(path), parsed) && parsed == path);
+	}
+
+	return TestResult("cpu_kernels_test");
+}
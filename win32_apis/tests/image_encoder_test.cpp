@@ -0,0 +1,468 @@
+﻿#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "image_encoder.hpp"
+#include "test_common.hpp"
+
+// Every encoder output is decoded by an independent reader written from the format specs
+// (PPM, PNG with its own inflate, QOI) and must give back the input pixels
+
+namespace
+{
+	uint32_t GetU32BE(const uint8_t* data)
+	{
+		return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+			(static_cast<uint32_t>(data[2]) << 8) | data[3];
+	}
+
+	// Pixels as the encoders store them: RGB, alpha forced to 0xFF
+	uint32_t Opaque(uint32_t color)
+	{
+		return color | 0xFF000000;
+	}
+
+	bool DecodePPM(const std::vector<uint8_t>& file, int& width, int& height, std::vector<uint32_t>& pixels)
+	{
+		const std::string text(file.begin(), file.begin() + std::min<size_t>(file.size(), 64));
+		int max_value = 0;
+		int header_size = 0;
+		if (std::sscanf(text.c_str(), "P6 %d %d %d%n", &width, &height, &max_value, &header_size) != 3 || max_value != 255)
+			return false;
+
+		// One whitespace byte ends the header
+		const size_t offset = static_cast<size_t>(header_size) + 1;
+		const size_t count = static_cast<size_t>(width) * height;
+		if (file.size() != offset + count * 3)
+			return false;
+
+		pixels.resize(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const uint8_t* rgb = file.data() + offset + i * 3;
+			pixels[i] = 0xFF000000 | (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+		}
+		return true;
+	}
+
+	// ------------------------------------------------------------------------
+	// Inflate (RFC 1951), stored and fixed Huffman blocks, which is all EncodePNG writes
+	// ------------------------------------------------------------------------
+	class BitReader
+	{
+	public:
+		BitReader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+		bool Bits(int count, uint32_t& value)
+		{
+			value = 0;
+			for (int i = 0; i < count; ++i)
+			{
+				if (m_position >= m_size * 8)
+					return false;
+
+				value |= static_cast<uint32_t>((m_data[m_position >> 3] >> (m_position & 7)) & 1) << i;
+				++m_position;
+			}
+			return true;
+		}
+
+		void AlignToByte() { m_position = (m_position + 7) & ~static_cast<size_t>(7); }
+		size_t GetBytePosition() const { return m_position >> 3; }
+		void SkipBytes(size_t count) { m_position += count * 8; }
+
+	private:
+		const uint8_t* m_data;
+		size_t m_size;
+		size_t m_position = 0;
+	};
+
+	// Canonical Huffman code from code lengths, decoded one bit at a time
+	struct Huffman
+	{
+		uint16_t counts[16] = {};
+		std::vector<uint16_t> symbols;
+
+		explicit Huffman(const std::vector<uint8_t>& lengths)
+		{
+			for (uint8_t length : lengths)
+				counts[length]++;
+			counts[0] = 0;
+
+			uint16_t offsets[16] = {};
+			for (int length = 1; length < 16; ++length)
+				offsets[length] = static_cast<uint16_t>(offsets[length - 1] + counts[length - 1]);
+
+			symbols.resize(lengths.size());
+			for (size_t symbol = 0; symbol < lengths.size(); ++symbol)
+			{
+				if (lengths[symbol] != 0)
+					symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+			}
+		}
+
+		bool Decode(BitReader& bits, int& symbol) const
+		{
+			int code = 0, first = 0, index = 0;
+			for (int length = 1; length < 16; ++length)
+			{
+				uint32_t bit;
+				if (!bits.Bits(1, bit))
+					return false;
+
+				code |= static_cast<int>(bit);
+				const int count = counts[length];
+				if (code - first < count)
+				{
+					symbol = symbols[index + code - first];
+					return true;
+				}
+
+				index += count;
+				first = (first + count) << 1;
+				code <<= 1;
+			}
+			return false;
+		}
+	};
+
+	bool Inflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+	{
+		static const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+			1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static const uint8_t distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		std::vector<uint8_t> literal_lengths(288);
+		for (int symbol = 0; symbol < 288; ++symbol)
+			literal_lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+		const Huffman fixed_literals(literal_lengths);
+		const Huffman fixed_distances(std::vector<uint8_t>(30, 5));
+
+		BitReader bits(data, size);
+		out.clear();
+
+		uint32_t last = 0;
+		while (last == 0)
+		{
+			uint32_t type;
+			if (!bits.Bits(1, last) || !bits.Bits(2, type))
+				return false;
+
+			if (type == 0)
+			{
+				bits.AlignToByte();
+				const size_t offset = bits.GetBytePosition();
+				if (offset + 4 > size)
+					return false;
+
+				const uint32_t length = data[offset] | (data[offset + 1] << 8);
+				const uint32_t inverse = data[offset + 2] | (data[offset + 3] << 8);
+				if ((length ^ 0xFFFF) != inverse || offset + 4 + length > size)
+					return false;
+
+				out.insert(out.end(), data + offset + 4, data + offset + 4 + length);
+				bits.SkipBytes(4 + length);
+				continue;
+			}
+
+			if (type != 1)
+				return false;
+
+			for (;;)
+			{
+				int symbol;
+				if (!fixed_literals.Decode(bits, symbol))
+					return false;
+
+				if (symbol < 256)
+				{
+					out.push_back(static_cast<uint8_t>(symbol));
+					continue;
+				}
+
+				if (symbol == 256)
+					break;
+
+				symbol -= 257;
+				uint32_t extra, distance_extra_bits;
+				int distance_symbol;
+				if (symbol >= 29 || !bits.Bits(length_extra[symbol], extra) ||
+					!fixed_distances.Decode(bits, distance_symbol) || distance_symbol >= 30 ||
+					!bits.Bits(distance_extra[distance_symbol], distance_extra_bits))
+					return false;
+
+				const size_t length = length_base[symbol] + extra;
+				const size_t distance = distance_base[distance_symbol] + distance_extra_bits;
+				if (distance > out.size())
+					return false;
+
+				for (size_t i = 0; i < length; ++i)
+					out.push_back(out[out.size() - distance]);
+			}
+		}
+
+		return bits.GetBytePosition() <= size;
+	}
+
+	uint32_t ReferenceCrc32(const uint8_t* data, size_t size)
+	{
+		uint32_t crc = 0xFFFFFFFF;
+		for (size_t i = 0; i < size; ++i)
+		{
+			crc ^= data[i];
+			for (int k = 0; k < 8; ++k)
+				crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+		}
+		return ~crc;
+	}
+
+	// Two modulo operations per byte, the plain definition
+	uint32_t ReferenceAdler32(const uint8_t* data, size_t size)
+	{
+		uint32_t s1 = 1, s2 = 0;
+		for (size_t i = 0; i < size; ++i)
+		{
+			s1 = (s1 + data[i]) % 65521;
+			s2 = (s2 + s1) % 65521;
+		}
+		return (s2 << 16) | s1;
+	}
+
+	bool DecodePNG(const std::vector<uint8_t>& file, int& width, int& height, std::vector<uint32_t>& pixels)
+	{
+		static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		if (file.size() < 8 || std::memcmp(file.data(), signature, 8) != 0)
+			return false;
+
+		std::vector<uint8_t> zlib;
+		bool has_header = false, has_end = false;
+
+		size_t offset = 8;
+		while (offset + 12 <= file.size() && !has_end)
+		{
+			const uint32_t length = GetU32BE(file.data() + offset);
+			if (offset + 12 + length > file.size())
+				return false;
+
+			const uint8_t* type = file.data() + offset + 4;
+			const uint8_t* payload = type + 4;
+			if (ReferenceCrc32(type, length + 4) != GetU32BE(payload + length))
+				return false;
+
+			if (std::memcmp(type, "IHDR", 4) == 0)
+			{
+				// 8 bit RGB, deflate, filter method 0, no interlace
+				width = static_cast<int>(GetU32BE(payload));
+				height = static_cast<int>(GetU32BE(payload + 4));
+				has_header = length == 13 && payload[8] == 8 && payload[9] == 2 && payload[10] == 0 && payload[11] == 0 && payload[12] == 0;
+			}
+			else if (std::memcmp(type, "IDAT", 4) == 0)
+			{
+				zlib.insert(zlib.end(), payload, payload + length);
+			}
+			else if (std::memcmp(type, "IEND", 4) == 0)
+			{
+				has_end = true;
+			}
+
+			offset += 12 + length;
+		}
+
+		// zlib header: deflate, 32K window, check bits, no dictionary
+		if (!has_header || !has_end || offset != file.size() || zlib.size() < 6 ||
+			(zlib[0] & 0x0F) != 8 || ((zlib[0] << 8) | zlib[1]) % 31 != 0 || (zlib[1] & 0x20) != 0)
+			return false;
+
+		std::vector<uint8_t> raw;
+		if (!Inflate(zlib.data() + 2, zlib.size() - 6, raw))
+			return false;
+
+		const size_t row_size = static_cast<size_t>(width) * 3 + 1;
+		if (raw.size() != row_size * height || ReferenceAdler32(raw.data(), raw.size()) != GetU32BE(zlib.data() + zlib.size() - 4))
+			return false;
+
+		pixels.resize(static_cast<size_t>(width) * height);
+		for (int y = 0; y < height; ++y)
+		{
+			const uint8_t* row = raw.data() + row_size * y;
+			if (row[0] != 0)
+				return false;
+
+			for (int x = 0; x < width; ++x)
+			{
+				const uint8_t* rgb = row + 1 + x * 3;
+				pixels[static_cast<size_t>(y) * width + x] = 0xFF000000 | (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+			}
+		}
+		return true;
+	}
+
+	// Straight from the QOI specification
+	bool DecodeQOI(const std::vector<uint8_t>& file, int& width, int& height, std::vector<uint32_t>& pixels)
+	{
+		static const uint8_t end_marker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+		if (file.size() < 14 + 8 || std::memcmp(file.data(), "qoif", 4) != 0 ||
+			std::memcmp(file.data() + file.size() - 8, end_marker, 8) != 0)
+			return false;
+
+		width = static_cast<int>(GetU32BE(file.data() + 4));
+		height = static_cast<int>(GetU32BE(file.data() + 8));
+		if (file[12] != 3 && file[12] != 4)
+			return false;
+
+		uint8_t index[64][4] = {};
+		uint8_t pixel[4] = { 0, 0, 0, 255 };
+		const size_t count = static_cast<size_t>(width) * height;
+		const size_t end = file.size() - 8;
+
+		pixels.clear();
+		size_t offset = 14;
+		while (pixels.size() < count)
+		{
+			if (offset >= end)
+				return false;
+
+			const uint8_t op = file[offset++];
+			int run = 1;
+
+			if (op == 0xFE || op == 0xFF)
+			{
+				const int channels = op == 0xFE ? 3 : 4;
+				if (offset + channels > end)
+					return false;
+				for (int c = 0; c < channels; ++c)
+					pixel[c] = file[offset++];
+			}
+			else if ((op & 0xC0) == 0x00)
+			{
+				std::memcpy(pixel, index[op], 4);
+			}
+			else if ((op & 0xC0) == 0x40)
+			{
+				pixel[0] = static_cast<uint8_t>(pixel[0] + ((op >> 4) & 3) - 2);
+				pixel[1] = static_cast<uint8_t>(pixel[1] + ((op >> 2) & 3) - 2);
+				pixel[2] = static_cast<uint8_t>(pixel[2] + (op & 3) - 2);
+			}
+			else if ((op & 0xC0) == 0x80)
+			{
+				if (offset >= end)
+					return false;
+				const int dg = (op & 0x3F) - 32;
+				const uint8_t second = file[offset++];
+				pixel[0] = static_cast<uint8_t>(pixel[0] + dg - 8 + (second >> 4));
+				pixel[1] = static_cast<uint8_t>(pixel[1] + dg);
+				pixel[2] = static_cast<uint8_t>(pixel[2] + dg - 8 + (second & 0x0F));
+			}
+			else
+			{
+				run = (op & 0x3F) + 1;
+			}
+
+			std::memcpy(index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+
+			for (int i = 0; i < run && pixels.size() < count; ++i)
+				pixels.push_back(0xFF000000 | (pixel[0] << 16) | (pixel[1] << 8) | pixel[2]);
+		}
+
+		return offset == end;
+	}
+
+	typedef bool (*DecodeFn)(const std::vector<uint8_t>&, int&, int&, std::vector<uint32_t>&);
+
+	void CheckRoundTrip(const char* name, ImageFormat format, DecodeFn decode, const std::vector<uint32_t>& image, int width, int height)
+	{
+		std::vector<uint8_t> file;
+		EncodeImage(format, image.data(), width, height, file);
+
+		int decoded_width = 0, decoded_height = 0;
+		std::vector<uint32_t> decoded;
+		const bool ok = decode(file, decoded_width, decoded_height, decoded);
+		CHECK(ok);
+		if (!ok)
+		{
+			std::cerr << "  " << name << " " << width << "x" << height << " did not decode\n";
+			return;
+		}
+
+		CHECK(decoded_width == width && decoded_height == height);
+
+		bool same = decoded.size() == image.size();
+		for (size_t i = 0; same && i < image.size(); ++i)
+			same = decoded[i] == Opaque(image[i]);
+
+		CHECK(same);
+		if (!same)
+			std::cerr << "  " << name << " " << width << "x" << height << " pixels differ\n";
+	}
+}
+
+int main()
+{
+	std::mt19937 random(7);
+
+	struct TestImage
+	{
+		int width;
+		int height;
+		int kind;		// 0 flat, 1 gradient, 2 noise, 3 flat with sprites
+	};
+
+	// Noise past 65535 bytes exercises the stored fallback with several blocks, flat frames the longest matches
+	const TestImage images[] = {
+		{ 1, 1, 0 }, { 1, 1, 2 }, { 7, 3, 1 }, { 1, 300, 1 }, { 64, 64, 0 }, { 257, 129, 1 },
+		{ 200, 200, 2 }, { 320, 180, 3 }, { 1280, 720, 3 }, { 33, 17, 2 }
+	};
+
+	for (const TestImage& test : images)
+	{
+		std::vector<uint32_t> image(static_cast<size_t>(test.width) * test.height);
+		for (int y = 0; y < test.height; ++y)
+		{
+			for (int x = 0; x < test.width; ++x)
+			{
+				uint32_t& pixel = image[static_cast<size_t>(y) * test.width + x];
+				switch (test.kind)
+				{
+				case 0: pixel = 0xFF333333; break;
+				case 1: pixel = 0xFF000000 | ((x * 255 / std::max(test.width - 1, 1)) << 16) | ((y * 255 / std::max(test.height - 1, 1)) << 8) | ((x + y) & 0xFF); break;
+				case 2: pixel = random(); break;
+				default: pixel = ((x / 8 + y / 8) % 5 == 0) ? 0xFF3A6EA5 + (random() % 4) : 0xFF333333; break;
+				}
+			}
+		}
+
+		CheckRoundTrip("PPM", ImageFormat::PPM, DecodePPM, image, test.width, test.height);
+		CheckRoundTrip("PNG", ImageFormat::PNG, DecodePNG, image, test.width, test.height);
+		CheckRoundTrip("QOI", ImageFormat::QOI, DecodeQOI, image, test.width, test.height);
+
+		// Raw video is the pixels as they are in memory
+		std::vector<uint8_t> raw;
+		EncodeImage(ImageFormat::RawVideo, image.data(), test.width, test.height, raw);
+		CHECK(raw.size() == image.size() * 4 && std::memcmp(raw.data(), image.data(), raw.size()) == 0);
+	}
+
+	// A mostly flat frame must compress, noise may not grow by more than the stored block overhead
+	std::vector<uint32_t> flat(640 * 480, 0xFF202020);
+	std::vector<uint8_t> png;
+	EncodePNG(flat.data(), 640, 480, png);
+	CHECK(png.size() < flat.size() * 3 / 100);
+
+	std::vector<uint32_t> noise(300 * 300);
+	for (uint32_t& pixel : noise)
+		pixel = random();
+	EncodePNG(noise.data(), 300, 300, png);
+	const size_t raw_size = (300 * 3 + 1) * 300;
+	CHECK(png.size() <= raw_size + (raw_size / 65535 + 1) * 5 + 64);
+
+	CHECK(ImageFormatFromPath("a/b.png") == ImageFormat::PNG);
+	CHECK(ImageFormatFromPath("frame_###.QOI") == ImageFormat::QOI);
+	CHECK(ImageFormatFromPath("x.ppm") == ImageFormat::PPM);
+	CHECK(ImageFormatFromPath("video.bgra") == ImageFormat::RawVideo);
+
+	return TestResult("image_encoder_test");
+}
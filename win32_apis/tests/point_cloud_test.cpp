@@ -0,0 +1,181 @@
+﻿#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "entropy_coder.hpp"
+#include "point_cloud.hpp"
+#include "test_common.hpp"
+
+// rANS blocks and the three .pcld encodings must round trip exactly, and damaged input must be
+// rejected instead of decoded or allocated
+
+namespace
+{
+	void CheckRansRoundTrip(const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> encoded;
+		RansEncode(data.data(), data.size(), encoded);
+
+		std::vector<uint8_t> decoded;
+		CHECK(RansDecode(encoded.data(), encoded.size(), data.size(), decoded));
+		CHECK(decoded == data);
+
+		if (data.empty())
+			return;
+
+		// One byte short of the claimed size is over the caller's bound
+		CHECK(!RansDecode(encoded.data(), encoded.size(), data.size() - 1, decoded));
+
+		// Cut off the last renormalization byte or the state
+		CHECK(!RansDecode(encoded.data(), encoded.size() - 1, data.size(), decoded));
+	}
+
+	void CheckRans(std::mt19937& random)
+	{
+		CheckRansRoundTrip({});
+		CheckRansRoundTrip({ 42 });
+		CheckRansRoundTrip(std::vector<uint8_t>(10000, 7));
+
+		std::vector<uint8_t> uniform(20000);
+		for (uint8_t& value : uniform)
+			value = static_cast<uint8_t>(random());
+		CheckRansRoundTrip(uniform);
+
+		// Skewed like delta varints: mostly small values, rare symbols keep a probability of 1/4096
+		std::vector<uint8_t> skewed(50000);
+		for (uint8_t& value : skewed)
+			value = static_cast<uint8_t>(random() % 100 == 0 ? random() : random() % 4);
+		CheckRansRoundTrip(skewed);
+
+		std::vector<uint8_t> encoded;
+		RansEncode(skewed.data(), skewed.size(), encoded);
+		CHECK(encoded.size() < skewed.size() / 2);
+
+		// A size field claiming 4 GB must fail on the bound, before the decoder allocates anything
+		std::vector<uint8_t> huge = encoded;
+		const uint32_t claimed = 0xFFFFFFF0u;
+		std::memcpy(huge.data(), &claimed, sizeof(claimed));
+		std::vector<uint8_t> decoded;
+		CHECK(!RansDecode(huge.data(), huge.size(), skewed.size(), decoded));
+		CHECK(decoded.size() <= skewed.size());
+
+		// Frequencies that do not sum to the probability scale
+		std::vector<uint8_t> damaged = encoded;
+		damaged[4] ^= 0x01;
+		CHECK(!RansDecode(damaged.data(), damaged.size(), skewed.size(), decoded));
+	}
+
+	std::vector<uint8_t> ReadFile(const std::string& path)
+	{
+		std::ifstream stream(path, std::ios::binary);
+		return std::vector<uint8_t>((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+	{
+		std::ofstream stream(path, std::ios::binary);
+		stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	}
+
+	bool SamePositions(const PointCloud& a, const PointCloud& b)
+	{
+		if (a.GetCount() != b.GetCount() || a.GetChunkCount() != b.GetChunkCount())
+			return false;
+
+		for (size_t i = 0; i < a.GetCount(); ++i)
+		{
+			const vec3_t pa = a.GetPosition(i);
+			const vec3_t pb = b.GetPosition(i);
+			if (std::memcmp(&pa, &pb, sizeof(vec3_t)) != 0)
+				return false;
+		}
+		return true;
+	}
+
+	void CheckPointCloud(std::mt19937& random, const std::string& path)
+	{
+		// Three chunks and a partial one, clustered points plus outliers so steps differ per chunk
+		const size_t count = 3 * POINT_CLOUD_CHUNK_SIZE + 123;
+		std::vector<float> xs(count), ys(count), zs(count);
+		std::normal_distribution<float> cluster(0.0f, 0.5f);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const bool outlier = random() % 50 == 0;
+			xs[i] = outlier ? std::uniform_real_distribution<float>(-100.0f, 100.0f)(random) : cluster(random);
+			ys[i] = cluster(random) + 3.0f;
+			zs[i] = outlier ? -42.0f : cluster(random) * 4.0f;
+		}
+
+		PointCloud cloud;
+		cloud.Build(xs.data(), ys.data(), zs.data(), count);
+		CHECK(cloud.GetCount() == count);
+
+		// Build reorders the points, so compare sums. Quantization moves each point by at most half a step
+		double input_sum = 0.0, stored_sum = 0.0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			const vec3_t p = cloud.GetPosition(i);
+			input_sum += xs[i] + ys[i] + zs[i];
+			stored_sum += p.x + p.y + p.z;
+		}
+		CHECK(std::abs(input_sum - stored_sum) < count * 0.01);
+
+		size_t sizes[3] = {};
+		int index = 0;
+		for (PointCloudEncoding encoding : { PointCloudEncoding::Raw, PointCloudEncoding::Delta, PointCloudEncoding::Entropy })
+		{
+			CHECK(cloud.Save(path, encoding));
+			sizes[index++] = ReadFile(path).size();
+
+			PointCloud loaded;
+			CHECK(loaded.Load(path));
+			CHECK(SamePositions(cloud, loaded));
+
+			PointCloudEncoding parsed;
+			CHECK(ParsePointCloudEncoding(GetPointCloudEncodingName(encoding), parsed) && parsed == encoding);
+		}
+
+		// Morton ordered clusters: deltas beat raw, rANS beats deltas
+		CHECK(sizes[1] < sizes[0] && sizes[2] < sizes[1]);
+
+		// Every truncation of an entropy coded file must be refused, not crash or half load
+		const std::vector<uint8_t> file = ReadFile(path);
+		for (size_t cut : { size_t(1), size_t(7), file.size() / 2, file.size() - 21 })
+		{
+			WriteFile(path, std::vector<uint8_t>(file.begin(), file.end() - cut));
+			PointCloud loaded;
+			CHECK(!loaded.Load(path));
+			CHECK(loaded.GetCount() == 0);
+		}
+
+		// Flipped payload bytes: rejected, or (if the damage decodes) never more points than the header says
+		std::mt19937 flips(3);
+		for (int trial = 0; trial < 50; ++trial)
+		{
+			std::vector<uint8_t> damaged = file;
+			damaged[20 + flips() % (damaged.size() - 20)] ^= static_cast<uint8_t>(1 + flips() % 255);
+			WriteFile(path, damaged);
+
+			PointCloud loaded;
+			if (loaded.Load(path))
+				CHECK(loaded.GetCount() == count);
+		}
+
+		std::remove(path.c_str());
+	}
+}
+
+int main()
+{
+	std::mt19937 random(11);
+	CheckRans(random);
+	CheckPointCloud(random, (std::filesystem::temp_directory_path() / "point_cloud_test.pcld").string());
+
+	return TestResult("point_cloud_test");
+}
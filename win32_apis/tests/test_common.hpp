@@ -0,0 +1,33 @@
+﻿#pragma once
+#include <iostream>
+
+// Minimal checks for the standalone test programs. A failed CHECK is reported and counted,
+// the test keeps going so one run shows every failure. main returns TestResult(...)
+
+inline int& TestFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #condition "\n"; \
+			++TestFailures(); \
+		} \
+	} while (0)
+
+inline int TestResult(const char* name)
+{
+	if (TestFailures() == 0)
+	{
+		std::cout << name << ": passed\n";
+		return 0;
+	}
+
+	std::cout << name << ": " << TestFailures() << " failed\n";
+	return 1;
+}
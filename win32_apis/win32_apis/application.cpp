@@ -9,11 +9,8 @@
 
 Application::Application()
 {
+	// May be null on platforms without a window backend, headless rendering still works
 	m_platform_adapter = GetPlatformAdapter();
-	if (!m_platform_adapter)
-	{
-		throw std::runtime_error("Unsupported platform!");
-	}
 
 	m_renderer = new Renderer();
 
@@ -21,6 +18,7 @@ Application::Application()
 
 Application::~Application()
 {
+	StopCapture();
 	delete m_platform_adapter;
 	delete m_renderer;
 }
@@ -33,11 +31,64 @@ void Application::SetupRenderer(uint32_t* color_buffer, int width, int height)
 		return;
 	}
 
-	m_renderer->Initialize(color_buffer, width, height);
+	m_renderer->Initialize(color_buffer, width, height, m_pixel_format, m_framebuffer_layout);
+
+	if (m_hud_enabled)
+	{
+		PerfCounters::SetEnabled(true);
+		m_renderer->SetOverlay(&m_hud);
+	}
+
+	if (!m_capture_path.empty() && m_capture.Open(m_capture_path, width, height, m_pixel_format, m_framebuffer_layout))
+	{
+		m_frame_index = 0;
+		FrameCapture::SetActive(&m_capture);
+	}
+}
+
+void Application::StopCapture()
+{
+	if (FrameCapture::GetActive() == &m_capture)
+		FrameCapture::SetActive(nullptr);
+
+	m_capture.Close();
+}
+
+void Application::RunFrame(int inDeltaTime, float inAspectRatio)
+{
+	if (m_capture.IsOpen())
+		m_capture.Record(CaptureRecord::FrameBegin, m_frame_index++, static_cast<int32_t>(inDeltaTime));
+
+	{
+		PerfScope scope(PerfCounter::UpdateTime);
+		Update(inDeltaTime);
+	}
+
+	PerfScope scope(PerfCounter::RenderTime);
+	Render(inAspectRatio);
+}
+
+void Application::KeyDown(int key)
+{
+	if (m_capture.IsOpen())
+		m_capture.Record(CaptureRecord::KeyDown, static_cast<int32_t>(key));
+
+	OnKeyDown(key);
+}
+
+void Application::SetFramebufferFormat(PixelFormat format, FramebufferLayout layout)
+{
+	m_pixel_format = format;
+	m_framebuffer_layout = layout;
 }
 
 void Application::StartWindowed(int x, int y, int width, int height, int antialiasing)
 {
+	if (!m_platform_adapter)
+	{
+		throw std::runtime_error("Unsupported platform!");
+	}
+
 	m_platform_adapter->StartWindowed(
 		x, 
 		y, 
@@ -50,10 +101,13 @@ void Application::StartWindowed(int x, int y, int width, int height, int antiali
 
 void Application::finish()
 {
+	StopCapture();
+
 	if (m_renderer)
 	{
 		m_renderer->Shutdown();
 	}
-	m_platform_adapter->finish(*this);
+	if (m_platform_adapter)
+		m_platform_adapter->finish(*this);
 }
 
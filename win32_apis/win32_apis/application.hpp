@@ -2,6 +2,8 @@
 
 #include "iplatform_adapter.hpp"
 #include "renderer.hpp"
+#include "frame_capture.hpp"
+#include "perf_hud.hpp"
 
 class Application
 {
@@ -14,11 +16,29 @@ public:
 	virtual void Update(int inDeltaTime) {}
 	virtual void Render(float inAspectRatio) {}
 	virtual void ShutDown() {}
+	virtual void OnKeyDown(int key) {}
+
+	// Scripted camera for headless runs (see BatchRenderer)
+	virtual void SetCameraPosition(const vec3_t& position) {}
 
 public:
 	void StartWindowed(int x, int y, int width, int height, int antialiasing);
 	void finish();
 
+	// One frame of Update + Render, recorded first when capturing. Platform adapters call these
+	// instead of the virtuals so a capture sees the same frames and input the application did
+	void RunFrame(int inDeltaTime, float inAspectRatio);
+	void KeyDown(int key);
+
+	// Must be called before StartWindowed to take effect
+	void SetFramebufferFormat(PixelFormat format, FramebufferLayout layout = FramebufferLayout::Linear);
+
+	// Records every frame to path from renderer setup until finish (see FrameCapture), empty to disable
+	void SetCapturePath(const std::string& path) { m_capture_path = path; }
+
+	// Performance overlay on every presented frame, also turns on PerfCounters. Must be called before StartWindowed
+	void SetHudEnabled(bool enabled) { m_hud_enabled = enabled; }
+
 public:
 	Renderer* GetRenderer() { return m_renderer; }
 
@@ -26,9 +46,21 @@ private:
 	IPlatformAdapter* m_platform_adapter;
 	Renderer* m_renderer;
 
+	PixelFormat m_pixel_format = PixelFormat::ARGB8888;
+	FramebufferLayout m_framebuffer_layout = FramebufferLayout::Linear;
+
+	std::string m_capture_path;
+	FrameCapture m_capture;
+	uint32_t m_frame_index = 0;
+
+	PerfHud m_hud;
+	bool m_hud_enabled = false;
+
 #ifdef _WIN32 // Allow WindowsAdapter to call SetupRe
 	friend class WindowsAdapter;
 #endif
+	friend class BatchRenderer;
 	void SetupRenderer(uint32_t* color_buffer, int width, int height);
+	void StopCapture();
 
 };
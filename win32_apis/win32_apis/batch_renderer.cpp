@@ -0,0 +1,264 @@
+﻿#include <iostream>
+#include <fstream>
+#include <algorithm>
+
+#include "batch_renderer.hpp"
+#include "job_system.hpp"
+
+BatchRenderer::BatchRenderer(const BatchSettings& settings) : m_settings(settings), m_failed(false)
+{
+	m_settings.frame_count = std::max(m_settings.frame_count, 0);
+	m_settings.max_frames_in_flight = std::max(m_settings.max_frames_in_flight, 2);
+
+	if (m_settings.encoder_threads <= 0)
+	{
+		// The calling thread renders and one thread writes, the rest encodes
+		int cores = static_cast<int>(std::thread::hardware_concurrency());
+		m_settings.encoder_threads = std::max(cores - 2, 1);
+	}
+}
+
+BatchRenderer::~BatchRenderer()
+{
+}
+
+bool BatchRenderer::Run(Application& app)
+{
+	if (m_settings.width <= 0 || m_settings.height <= 0)
+	{
+		std::cerr << "Batch renderer: invalid frame size " << m_settings.width << "x" << m_settings.height << "\n";
+		return false;
+	}
+
+	const size_t pixel_count = static_cast<size_t>(m_settings.width) * m_settings.height;
+
+	m_failed = false;
+	m_rendering_done = false;
+	m_encoding_done = false;
+	m_free_jobs.clear();
+	m_encode_queue.clear();
+	m_encoded_frames.clear();
+
+	m_jobs.resize(m_settings.max_frames_in_flight);
+	for (FrameJob& job : m_jobs)
+	{
+		job.pixels.resize(pixel_count);
+		m_free_jobs.push_back(&job);
+	}
+
+	// Every frame is presented straight into a job buffer, the first one is only needed to initialize
+	app.SetFramebufferFormat(m_settings.pixel_format, m_settings.layout);
+
+	if (Renderer* target = app.GetRenderer())
+	{
+		FramebufferMemoryOptions memory;
+		memory.huge_pages = m_settings.huge_pages;
+		memory.first_touch = &JobSystem::GetInstance();
+		target->SetMemoryOptions(memory);
+	}
+
+	app.SetupRenderer(m_jobs[0].pixels.data(), m_settings.width, m_settings.height);
+
+	Renderer* renderer = app.GetRenderer();
+	if (!renderer || renderer->GetBufferWidth() != m_settings.width)
+	{
+		std::cerr << "Batch renderer: renderer setup failed!\n";
+		return false;
+	}
+
+	app.Initialize();
+
+	for (int i = 0; i < m_settings.encoder_threads; ++i)
+	{
+		m_encoders.emplace_back(&BatchRenderer::EncodeWorker, this);
+	}
+	m_writer = std::thread(&BatchRenderer::WriteWorker, this);
+
+	const float aspect = m_settings.width / static_cast<float>(m_settings.height);
+
+	for (int frame = 0; frame < m_settings.frame_count && !m_failed; ++frame)
+	{
+		if (m_settings.camera_path)
+			app.SetCameraPosition(m_settings.camera_path(frame));
+
+		app.RunFrame(m_settings.frame_time_ms, aspect);
+
+		FrameJob* job = AcquireJob();
+		if (!job)
+			break;
+
+		renderer->SetFrontBuffer(job->pixels.data());
+		renderer->SwapBuffers();
+		job->index = frame;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_encode_queue.push_back(job);
+		}
+		m_job_available.notify_all();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_rendering_done = true;
+	}
+	m_job_available.notify_all();
+
+	for (std::thread& encoder : m_encoders)
+	{
+		encoder.join();
+	}
+	m_encoders.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_encoding_done = true;
+	}
+	m_frame_encoded.notify_all();
+
+	m_writer.join();
+
+	app.ShutDown();
+	app.StopCapture();
+	renderer->Shutdown();
+
+	return !m_failed;
+}
+
+void BatchRenderer::EncodeWorker()
+{
+	for (;;)
+	{
+		FrameJob* job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_job_available.wait(lock, [this] { return !m_encode_queue.empty() || m_rendering_done; });
+
+			if (m_encode_queue.empty())
+				return;
+
+			job = m_encode_queue.front();
+			m_encode_queue.pop_front();
+		}
+
+		if (WritesFiles())
+			EncodeImage(m_settings.format, job->pixels.data(), m_settings.width, m_settings.height, job->encoded);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_encoded_frames[job->index] = job;
+		}
+		m_frame_encoded.notify_all();
+	}
+}
+
+void BatchRenderer::WriteWorker()
+{
+	std::ofstream stream;
+	if (WritesFiles() && m_settings.format == ImageFormat::RawVideo)
+	{
+		stream.open(m_settings.output_path, std::ios::binary | std::ios::trunc);
+		if (!stream)
+		{
+			std::cerr << "Batch renderer: failed to open " << m_settings.output_path << "\n";
+			m_failed = true;
+		}
+	}
+
+	for (int next = 0;; ++next)
+	{
+		FrameJob* job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_frame_encoded.wait(lock, [this, next] { return m_encoded_frames.count(next) || m_encoding_done; });
+
+			auto it = m_encoded_frames.find(next);
+			if (it == m_encoded_frames.end())
+				break;
+
+			job = it->second;
+			m_encoded_frames.erase(it);
+		}
+
+		// After a failure frames are still drained so rendering never blocks on a full pool
+		if (!m_failed && m_settings.sink)
+		{
+			// A dropped frame is the sink's business, not a batch failure
+			m_settings.sink->PublishFrame(job->pixels.data(), m_settings.width, m_settings.height);
+		}
+
+		if (!m_failed && WritesFiles())
+		{
+			if (m_settings.format == ImageFormat::RawVideo)
+			{
+				stream.write(reinterpret_cast<const char*>(job->encoded.data()), job->encoded.size());
+			}
+			else
+			{
+				std::string path = GetFramePath(job->index);
+				stream.open(path, std::ios::binary | std::ios::trunc);
+				stream.write(reinterpret_cast<const char*>(job->encoded.data()), job->encoded.size());
+				stream.close();
+			}
+
+			if (!stream)
+			{
+				std::cerr << "Batch renderer: failed to write frame " << job->index << "\n";
+				m_failed = true;
+			}
+		}
+
+		ReleaseJob(job);
+	}
+}
+
+BatchRenderer::FrameJob* BatchRenderer::AcquireJob()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_job_available.wait(lock, [this] { return !m_free_jobs.empty() || m_failed; });
+
+	if (m_free_jobs.empty())
+		return nullptr;
+
+	FrameJob* job = m_free_jobs.back();
+	m_free_jobs.pop_back();
+
+	return job;
+}
+
+void BatchRenderer::ReleaseJob(FrameJob* job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_free_jobs.push_back(job);
+	}
+	m_job_available.notify_all();
+}
+
+std::string BatchRenderer::GetFramePath(int index) const
+{
+	const std::string& pattern = m_settings.output_path;
+	std::string number = std::to_string(index);
+
+	size_t first = pattern.find('#');
+	if (first == std::string::npos)
+	{
+		// No placeholder, insert the number before the extension
+		size_t dot = pattern.find_last_of('.');
+		size_t slash = pattern.find_last_of("/\\");
+		if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+			dot = pattern.size();
+
+		return pattern.substr(0, dot) + "_" + number + pattern.substr(dot);
+	}
+
+	size_t last = pattern.find_first_not_of('#', first);
+	if (last == std::string::npos)
+		last = pattern.size();
+
+	size_t width = last - first;
+	if (number.size() < width)
+		number.insert(0, width - number.size(), '0');
+
+	return pattern.substr(0, first) + number + pattern.substr(last);
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "application.hpp"
+#include "image_encoder.hpp"
+#include "iframe_sink.hpp"
+#include "vector.h"
+
+struct BatchSettings
+{
+	int width = 1280;
+	int height = 720;
+	int frame_count = 1;
+	int frame_time_ms = 16;				// dt passed to Application::Update
+
+	// Image sequences replace the run of '#' with the zero padded frame number ("out/frame_#####.qoi"),
+	// RawVideo writes every frame to this one file. Empty = no files, e.g. when only a sink is wanted
+	std::string output_path = "frame_#####.qoi";
+	ImageFormat format = ImageFormat::QOI;
+
+	int encoder_threads = 0;			// 0 = one per remaining core
+	int max_frames_in_flight = 8;		// Rendering blocks when encoding/writing falls this far behind
+
+	PixelFormat pixel_format = PixelFormat::ARGB8888;
+	FramebufferLayout layout = FramebufferLayout::Linear;
+	bool huge_pages = false;			// See FramebufferMemoryOptions, the back buffer is always first touched by the job system
+
+	// Scripted camera, called before every frame's Update
+	std::function<vec3_t(int frame)> camera_path;
+
+	// Optional extra output, receives every frame in order from the write thread
+	IFrameSink* sink = nullptr;
+};
+
+// Headless driver: renders frames on the calling thread while encoder threads compress
+// and a dedicated I/O thread writes the results in frame order
+class BatchRenderer
+{
+public:
+	explicit BatchRenderer(const BatchSettings& settings);
+	~BatchRenderer();
+
+public:
+	// Returns false if any frame failed to encode or write
+	bool Run(Application& app);
+
+private:
+	struct FrameJob
+	{
+		int index = 0;
+		std::vector<uint32_t> pixels;
+		std::vector<uint8_t> encoded;
+	};
+
+	void EncodeWorker();
+	void WriteWorker();
+
+	FrameJob* AcquireJob();
+	void ReleaseJob(FrameJob* job);
+	std::string GetFramePath(int index) const;
+	bool WritesFiles() const { return !m_settings.output_path.empty(); }
+
+private:
+	BatchSettings m_settings;
+
+	std::mutex m_mutex;
+	std::condition_variable m_job_available;	// Free pool or encode queue changed
+	std::condition_variable m_frame_encoded;	// A frame finished encoding
+
+	std::vector<FrameJob*> m_free_jobs;
+	std::deque<FrameJob*> m_encode_queue;
+	std::map<int, FrameJob*> m_encoded_frames;	// Reordered before writing
+	std::vector<FrameJob> m_jobs;
+
+	std::vector<std::thread> m_encoders;
+	std::thread m_writer;
+
+	bool m_rendering_done = false;
+	bool m_encoding_done = false;
+	std::atomic<bool> m_failed;
+};
@@ -0,0 +1,358 @@
+﻿#include <algorithm>
+#include <cmath>
+
+#include "bin_rasterizer.hpp"
+#include "clipping.hpp"
+
+namespace
+{
+	typedef FramebufferView<PixelARGB8888, LinearLayout> TileView;
+
+	// Grid lines on multiples of spacing from the grid origin, inside the local rect [x0, x1) x [y0, y1).
+	// grid_x/grid_y is the grid origin relative to the tile
+	template<BlendMode Mode>
+	void DrawGridTile(const TileView& view, int x0, int y0, int x1, int y1, int grid_x, int grid_y, int spacing, uint32_t color)
+	{
+		// First column at or after x0 on the grid, the offsets are never negative
+		const int first_column = x0 + ((grid_x - x0) % spacing + spacing) % spacing;
+
+		for (int y = y0; y < y1; ++y)
+		{
+			if ((y - grid_y) % spacing == 0)
+			{
+				FillSpanKernel<Mode, ClipMode::None>(view, x0, y, x1 - x0, color);
+				continue;
+			}
+
+			for (int x = first_column; x < x1; x += spacing)
+			{
+				PutPixelKernel<Mode, ClipMode::None>(view, x, y, color);
+			}
+		}
+	}
+
+	inline BlendMode GetBlendMode(uint32_t color)
+	{
+		return ((color >> 24) & 0xFF) == 255 ? BlendMode::Opaque : BlendMode::Alpha;
+	}
+}
+
+void BinRasterizer::Begin(Renderer& renderer)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::BinBegin);
+
+	m_renderer = &renderer;
+	m_width = renderer.GetBufferWidth();
+	m_height = renderer.GetBufferHeight();
+	m_tiles_x = (m_width + BIN_TILE_SIZE - 1) / BIN_TILE_SIZE;
+	m_tiles_y = (m_height + BIN_TILE_SIZE - 1) / BIN_TILE_SIZE;
+
+	// Lists keep their capacity between frames
+	m_tiles.resize(static_cast<size_t>(m_tiles_x) * m_tiles_y);
+	for (Tile& tile : m_tiles)
+	{
+		tile.commands.clear();
+		tile.covered = false;
+	}
+
+	m_commands.clear();
+	m_vertices.clear();
+
+	m_viewport = { 0, 0, m_width, m_height };
+}
+
+void BinRasterizer::SetViewport(const Viewport& viewport)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::BinViewport, viewport.x, viewport.y, viewport.width, viewport.height);
+
+	// Clamped to the buffer so commands never need to clip against it again
+	int x0 = std::max(viewport.x, 0);
+	int y0 = std::max(viewport.y, 0);
+	int x1 = std::min(viewport.x + viewport.width, m_width);
+	int y1 = std::min(viewport.y + viewport.height, m_height);
+
+	m_viewport = { x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0) };
+}
+
+void BinRasterizer::ClearColorBuffer(uint32_t color)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::BinClear, color);
+
+	Command command = {};
+	command.type = CommandType::Clear;
+	command.mode = BlendMode::Opaque;
+	command.color = color;
+	command.x = m_viewport.x;
+	command.y = m_viewport.y;
+	command.width = m_viewport.width;
+	command.height = m_viewport.height;
+
+	Bin(command, command.x, command.y, command.x + command.width, command.y + command.height);
+}
+
+void BinRasterizer::DrawGrid(uint32_t color, int spacing)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::BinGrid, color, spacing);
+
+	if (spacing <= 0 || ((color >> 24) & 0xFF) == 0)
+		return;
+
+	Command command = {};
+	command.type = CommandType::Grid;
+	command.mode = GetBlendMode(color);
+	command.color = color;
+	command.x = m_viewport.x;
+	command.y = m_viewport.y;
+	command.width = m_viewport.width;
+	command.height = m_viewport.height;
+	command.spacing = spacing;
+
+	Bin(command, command.x, command.y, command.x + command.width, command.y + command.height);
+}
+
+void BinRasterizer::DrawRectangle(int x, int y, int width, int height, uint32_t color)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::BinRect, x, y, width, height, color);
+
+	if (((color >> 24) & 0xFF) == 0)
+		return;
+
+	// Width and height are inclusive like Renderer::DrawRectangle, clipped to the viewport up front
+	x += m_viewport.x;
+	y += m_viewport.y;
+
+	int x0 = std::max(x, m_viewport.x);
+	int y0 = std::max(y, m_viewport.y);
+	int x1 = std::min(x + width + 1, m_viewport.x + m_viewport.width);
+	int y1 = std::min(y + height + 1, m_viewport.y + m_viewport.height);
+	if (x1 <= x0 || y1 <= y0)
+	{
+		PerfCounters::Add(PerfCounter::PrimitivesCulled, 1);
+		return;
+	}
+
+	PerfCounters::Add(PerfCounter::PrimitivesDrawn, 1);
+
+	Command command = {};
+	command.type = CommandType::Rect;
+	command.mode = GetBlendMode(color);
+	command.color = color;
+	command.x = x0;
+	command.y = y0;
+	command.width = x1 - x0;
+	command.height = y1 - y0;
+
+	Bin(command, x0, y0, x1, y1);
+}
+
+void BinRasterizer::DrawTriangle(const vec2_t& a, const vec2_t& b, const vec2_t& c, uint32_t color)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::BinTriangle, a, b, c, color);
+
+	if (((color >> 24) & 0xFF) == 0)
+		return;
+
+	const float origin_x = static_cast<float>(m_viewport.x);
+	const float origin_y = static_cast<float>(m_viewport.y);
+	const vec2_t triangle[3] = { vec2_t(a.x + origin_x, a.y + origin_y), vec2_t(b.x + origin_x, b.y + origin_y), vec2_t(c.x + origin_x, c.y + origin_y) };
+
+	vec2_t polygon[CLIP_MAX_VERTICES] = { triangle[0], triangle[1], triangle[2] };
+	int count = 3;
+
+	float min_x = std::min({ triangle[0].x, triangle[1].x, triangle[2].x }), max_x = std::max({ triangle[0].x, triangle[1].x, triangle[2].x });
+	float min_y = std::min({ triangle[0].y, triangle[1].y, triangle[2].y }), max_y = std::max({ triangle[0].y, triangle[1].y, triangle[2].y });
+
+	const float right = origin_x + m_viewport.width;
+	const float bottom = origin_y + m_viewport.height;
+	if (max_x < origin_x || max_y < origin_y || min_x >= right || min_y >= bottom)
+	{
+		PerfCounters::Add(PerfCounter::PrimitivesCulled, 1);
+		return;
+	}
+
+	// Full buffer: same guard band as Renderer::DrawConvexPolygon. A smaller viewport acts as a scissor,
+	// so clip to it exactly and the kernel's view bounds never see pixels of a neighbouring view
+	const bool scissor = m_viewport.width != m_width || m_viewport.height != m_height;
+	const ClipRect clip = scissor ? ClipRect{ origin_x, origin_y, right, bottom } :
+		ClipRect{ -GUARD_BAND_MARGIN, -GUARD_BAND_MARGIN, right + GUARD_BAND_MARGIN, bottom + GUARD_BAND_MARGIN };
+
+	if (min_x < clip.min_x || min_y < clip.min_y || max_x > clip.max_x || max_y > clip.max_y)
+	{
+		count = ClipPolygonRect(triangle, 3, polygon, clip);
+		if (count < 3)
+		{
+			PerfCounters::Add(PerfCounter::PrimitivesCulled, 1);
+			return;
+		}
+	}
+
+	PerfCounters::Add(PerfCounter::PrimitivesDrawn, 1);
+
+	Command command = {};
+	command.type = CommandType::Polygon;
+	command.mode = GetBlendMode(color);
+	command.color = color;
+	command.first_vertex = static_cast<uint32_t>(m_vertices.size());
+	command.vertex_count = static_cast<uint32_t>(count);
+	m_vertices.insert(m_vertices.end(), polygon, polygon + count);
+
+	// Pixel centers inside the bounds, one pixel of slack each side
+	int x0 = std::max(static_cast<int>(std::floor(min_x)) - 1, m_viewport.x);
+	int y0 = std::max(static_cast<int>(std::floor(min_y)) - 1, m_viewport.y);
+	int x1 = std::min(static_cast<int>(std::ceil(std::min(max_x, right))) + 1, m_viewport.x + m_viewport.width);
+	int y1 = std::min(static_cast<int>(std::ceil(std::min(max_y, bottom))) + 1, m_viewport.y + m_viewport.height);
+
+	Bin(command, x0, y0, x1, y1);
+}
+
+void BinRasterizer::Bin(const Command& command, int x0, int y0, int x1, int y1)
+{
+	if (!m_renderer || x1 <= x0 || y1 <= y0)
+		return;
+
+	const uint32_t index = static_cast<uint32_t>(m_commands.size());
+	m_commands.push_back(command);
+
+	const bool opaque_cover = command.type == CommandType::Clear ||
+		(command.type == CommandType::Rect && command.mode == BlendMode::Opaque);
+
+	for (int ty = y0 / BIN_TILE_SIZE; ty <= (y1 - 1) / BIN_TILE_SIZE; ++ty)
+	{
+		for (int tx = x0 / BIN_TILE_SIZE; tx <= (x1 - 1) / BIN_TILE_SIZE; ++tx)
+		{
+			Tile& tile = m_tiles[static_cast<size_t>(ty) * m_tiles_x + tx];
+
+			// Everything before an opaque full-tile command is overdraw, drop it
+			if (opaque_cover)
+			{
+				int tile_x0 = tx * BIN_TILE_SIZE, tile_y0 = ty * BIN_TILE_SIZE;
+				int tile_x1 = std::min(tile_x0 + BIN_TILE_SIZE, m_width), tile_y1 = std::min(tile_y0 + BIN_TILE_SIZE, m_height);
+
+				if (x0 <= tile_x0 && y0 <= tile_y0 && x1 >= tile_x1 && y1 >= tile_y1)
+				{
+					tile.commands.clear();
+					tile.covered = true;
+				}
+			}
+
+			tile.commands.push_back(index);
+		}
+	}
+}
+
+void BinRasterizer::Flush(JobSystem& jobs)
+{
+	// Recorded here on the calling thread, the tile jobs below never touch the capture
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::BinFlush);
+
+	if (!m_renderer || m_tiles.empty())
+		return;
+
+	PerfScope scope(PerfCounter::RasterTime);
+
+	jobs.ParallelFor(m_tiles.size(), 4, [this](size_t begin, size_t end)
+	{
+		// Tile local color buffer, lives in this worker's cache for the whole tile
+		alignas(64) uint32_t pixels[BIN_TILE_SIZE * BIN_TILE_SIZE];
+
+		for (size_t i = begin; i < end; ++i)
+		{
+			// Untouched tiles cost neither a read nor a write
+			if (m_tiles[i].commands.empty())
+				continue;
+
+			RasterizeTile(static_cast<int>(i), pixels);
+		}
+	});
+}
+
+void BinRasterizer::RasterizeTile(int tile_index, uint32_t* pixels) const
+{
+	const Tile& tile = m_tiles[tile_index];
+	const int origin_x = (tile_index % m_tiles_x) * BIN_TILE_SIZE;
+	const int origin_y = (tile_index / m_tiles_x) * BIN_TILE_SIZE;
+	const int width = std::min(BIN_TILE_SIZE, m_width - origin_x);
+	const int height = std::min(BIN_TILE_SIZE, m_height - origin_y);
+
+	if (!tile.covered)
+		m_renderer->ReadTile(origin_x, origin_y, width, height, pixels, width);
+
+	const TileView view = { pixels, width, height, 0 };
+
+	for (uint32_t index : tile.commands)
+	{
+		const Command& command = m_commands[index];
+		const bool opaque = command.mode == BlendMode::Opaque;
+
+		switch (command.type)
+		{
+		case CommandType::Clear:
+		{
+			int x = command.x - origin_x;
+			int y = command.y - origin_y;
+
+			if (x <= 0 && y <= 0 && x + command.width >= width && y + command.height >= height)
+			{
+				PerfCounters::Add(PerfCounter::PixelsFilled, static_cast<uint64_t>(width) * height);
+				GetCpuKernels().fill(pixels, static_cast<size_t>(width) * height, command.color);
+			}
+			else
+				FillRectKernel<BlendMode::Opaque, ClipMode::Clip>(view, x, y, command.width, command.height, command.color);
+			break;
+		}
+
+		case CommandType::Grid:
+		{
+			int grid_x = command.x - origin_x;
+			int grid_y = command.y - origin_y;
+			int x0 = std::max(grid_x, 0), x1 = std::min(grid_x + command.width, width);
+			int y0 = std::max(grid_y, 0), y1 = std::min(grid_y + command.height, height);
+
+			if (opaque)
+				DrawGridTile<BlendMode::Opaque>(view, x0, y0, x1, y1, grid_x, grid_y, command.spacing, command.color);
+			else
+				DrawGridTile<BlendMode::Alpha>(view, x0, y0, x1, y1, grid_x, grid_y, command.spacing, command.color);
+			break;
+		}
+
+		case CommandType::Rect:
+		{
+			int x = command.x - origin_x;
+			int y = command.y - origin_y;
+
+			if (opaque)
+				FillRectKernel<BlendMode::Opaque, ClipMode::Clip>(view, x, y, command.width, command.height, command.color);
+			else
+				FillRectKernel<BlendMode::Alpha, ClipMode::Clip>(view, x, y, command.width, command.height, command.color);
+			break;
+		}
+
+		case CommandType::Polygon:
+		{
+			vec2_t local[CLIP_MAX_VERTICES];
+			const vec2_t* vertices = m_vertices.data() + command.first_vertex;
+			const int count = static_cast<int>(command.vertex_count);
+
+			for (int i = 0; i < count; ++i)
+			{
+				local[i] = vec2_t(vertices[i].x - origin_x, vertices[i].y - origin_y);
+			}
+
+			if (opaque)
+				FillConvexPolygonKernel<BlendMode::Opaque>(view, local, count, command.color);
+			else
+				FillConvexPolygonKernel<BlendMode::Alpha>(view, local, count, command.color);
+			break;
+		}
+		}
+	}
+
+	m_renderer->WriteTile(origin_x, origin_y, width, height, pixels, width);
+}
@@ -0,0 +1,79 @@
+﻿#pragma once
+#include <stdint.h>
+#include <vector>
+
+#include "renderer.hpp"
+#include "job_system.hpp"
+#include "render_view.hpp"
+#include "vector.h"
+
+// Screen tile edge in pixels, a 32-bit tile (16 KB) stays resident in L1/L2 while it is rasterized
+#define BIN_TILE_SIZE 64
+
+// Two-phase renderer: draw calls are binned into per-tile command lists, Flush then rasterizes
+// every tile in a local buffer and writes it back to the Renderer once
+class BinRasterizer
+{
+public:
+	BinRasterizer() = default;
+
+public:
+	// Starts a new frame sized to the renderer's buffer, the viewport covers the whole buffer
+	void Begin(Renderer& renderer);
+
+	// Following draw calls use coordinates relative to the viewport origin and are clipped to it.
+	// Every view of a frame is flushed together, so the tiles of all views rasterize in parallel
+	void SetViewport(const Viewport& viewport);
+	const Viewport& GetViewport() const { return m_viewport; }
+
+	// Same semantics as the Renderer calls of the same name, within the current viewport
+	void ClearColorBuffer(uint32_t color);
+	void DrawGrid(uint32_t color, int spacing = 10);
+	void DrawRectangle(int x, int y, int width, int height, uint32_t color);
+	void DrawTriangle(const vec2_t& a, const vec2_t& b, const vec2_t& c, uint32_t color);
+
+	// Rasterizes all tiles in parallel and writes them back
+	void Flush(JobSystem& jobs);
+
+private:
+	enum class CommandType : uint8_t
+	{
+		Clear,
+		Grid,
+		Rect,
+		Polygon
+	};
+
+	struct Command
+	{
+		CommandType type;
+		BlendMode mode;
+		uint32_t color;
+		int x, y, width, height;	// Clear/grid/rect bounds in buffer pixels
+		int spacing;				// Grid, lines are relative to x, y
+		uint32_t first_vertex;		// Polygon vertices in m_vertices
+		uint32_t vertex_count;
+	};
+
+	struct Tile
+	{
+		std::vector<uint32_t> commands;
+		bool covered;				// An opaque command overwrites the whole tile, no need to load it
+	};
+
+	// Appends command to every tile overlapping the pixel rect [x0, x1) x [y0, y1)
+	void Bin(const Command& command, int x0, int y0, int x1, int y1);
+	void RasterizeTile(int tile_index, uint32_t* pixels) const;
+
+private:
+	Renderer* m_renderer = nullptr;
+	int m_width = 0;
+	int m_height = 0;
+	int m_tiles_x = 0;
+	int m_tiles_y = 0;
+	Viewport m_viewport;
+
+	std::vector<Command> m_commands;
+	std::vector<vec2_t> m_vertices;
+	std::vector<Tile> m_tiles;
+};
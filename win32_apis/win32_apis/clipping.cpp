@@ -0,0 +1,153 @@
+﻿#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "clipping.hpp"
+
+namespace
+{
+	inline vec3_t Lerp(const vec3_t& a, const vec3_t& b, float t)
+	{
+		return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+	}
+
+	inline vec2_t Lerp(const vec2_t& a, const vec2_t& b, float t)
+	{
+		return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t };
+	}
+
+	inline vec2_t ClampToRect(const vec2_t& v, const ClipRect& rect)
+	{
+		return { std::min(std::max(v.x, rect.min_x), rect.max_x), std::min(std::max(v.y, rect.min_y), rect.max_y) };
+	}
+
+	// One Sutherland-Hodgman pass, distance(v) >= 0 is inside
+	template<typename Vertex, typename Distance>
+	int ClipAgainstPlane(const Vertex* in, int count, Vertex* out, Distance distance)
+	{
+		int out_count = 0;
+
+		for (int i = 0; i < count; ++i)
+		{
+			const Vertex& current = in[i];
+			const Vertex& next = in[(i + 1) % count];
+			float d_current = distance(current);
+			float d_next = distance(next);
+
+			if (d_current >= 0.0f)
+				out[out_count++] = current;
+
+			// Edge crosses the plane, emit the intersection
+			if ((d_current >= 0.0f) != (d_next >= 0.0f))
+				out[out_count++] = Lerp(current, next, d_current / (d_current - d_next));
+		}
+
+		return out_count;
+	}
+
+	// Liang-Barsky step for p * t <= q, narrows [t0, t1]
+	inline bool ClipTest(float p, float q, float& t0, float& t1)
+	{
+		if (p == 0.0f)
+			return q >= 0.0f;
+
+		float t = q / p;
+		if (p < 0.0f)
+		{
+			if (t > t1) return false;
+			if (t > t0) t0 = t;
+		}
+		else
+		{
+			if (t < t0) return false;
+			if (t < t1) t1 = t;
+		}
+
+		return true;
+	}
+}
+
+bool ClipSegmentDepth(vec3_t& a, vec3_t& b, float near_z, float far_z)
+{
+	float t0 = 0.0f;
+	float t1 = 1.0f;
+	float dz = b.z - a.z;
+
+	if (!ClipTest(-dz, a.z - near_z, t0, t1)) return false;
+	if (!ClipTest(dz, far_z - a.z, t0, t1)) return false;
+
+	vec3_t start = a;
+	vec3_t end = b;
+	if (t0 > 0.0f) a = Lerp(start, end, t0);
+	if (t1 < 1.0f) b = Lerp(start, end, t1);
+
+	return true;
+}
+
+int ClipPolygonDepth(const vec3_t* in, int count, vec3_t* out, float near_z, float far_z)
+{
+	// Larger polygons are rare, only they pay for a heap scratch
+	vec3_t local[CLIP_MAX_VERTICES];
+	std::vector<vec3_t> heap;
+	vec3_t* temp = local;
+	if (count + 2 > CLIP_MAX_VERTICES)
+	{
+		heap.resize(count + 2);
+		temp = heap.data();
+	}
+
+	int near_count = ClipAgainstPlane(in, count, temp, [near_z](const vec3_t& v) { return v.z - near_z; });
+	if (near_count == 0)
+		return 0;
+
+	return ClipAgainstPlane(temp, near_count, out, [far_z](const vec3_t& v) { return far_z - v.z; });
+}
+
+bool ClipSegmentRect(vec2_t& a, vec2_t& b, const ClipRect& rect)
+{
+	// NaN passes every Liang-Barsky test, callers rasterize the result without bounds checks
+	if (!std::isfinite(a.x) || !std::isfinite(a.y) || !std::isfinite(b.x) || !std::isfinite(b.y))
+		return false;
+
+	float t0 = 0.0f;
+	float t1 = 1.0f;
+	float dx = b.x - a.x;
+	float dy = b.y - a.y;
+
+	if (!ClipTest(-dx, a.x - rect.min_x, t0, t1)) return false;
+	if (!ClipTest(dx, rect.max_x - a.x, t0, t1)) return false;
+	if (!ClipTest(-dy, a.y - rect.min_y, t0, t1)) return false;
+	if (!ClipTest(dy, rect.max_y - a.y, t0, t1)) return false;
+
+	vec2_t start = a;
+	vec2_t end = b;
+	if (t0 > 0.0f) a = Lerp(start, end, t0);
+	if (t1 < 1.0f) b = Lerp(start, end, t1);
+
+	// Huge inputs lose the intersection to rounding, the result is still guaranteed to be inside
+	a = ClampToRect(a, rect);
+	b = ClampToRect(b, rect);
+
+	return true;
+}
+
+int ClipPolygonRect(const vec2_t* in, int count, vec2_t* out, const ClipRect& rect)
+{
+	vec2_t local[CLIP_MAX_VERTICES];
+	std::vector<vec2_t> heap;
+	vec2_t* temp = local;
+	if (count + 4 > CLIP_MAX_VERTICES)
+	{
+		heap.resize(count + 4);
+		temp = heap.data();
+	}
+
+	count = ClipAgainstPlane(in, count, temp, [&rect](const vec2_t& v) { return v.x - rect.min_x; });
+	if (count == 0) return 0;
+	count = ClipAgainstPlane(temp, count, out, [&rect](const vec2_t& v) { return rect.max_x - v.x; });
+	if (count == 0) return 0;
+	count = ClipAgainstPlane(out, count, temp, [&rect](const vec2_t& v) { return v.y - rect.min_y; });
+	if (count == 0) return 0;
+
+	return ClipAgainstPlane(temp, count, out, [&rect](const vec2_t& v) { return rect.max_y - v.y; });
+}
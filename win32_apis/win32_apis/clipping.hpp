@@ -0,0 +1,26 @@
+﻿#pragma once
+#include "vector.h"
+
+// Enough room for a triangle clipped against 2 depth planes, or a pentagon against 4 rect edges.
+// Scratch size for the common case, the polygon clips below take any vertex count
+#define CLIP_MAX_VERTICES 9
+
+struct ClipRect
+{
+	float min_x;
+	float min_y;
+	float max_x;
+	float max_y;
+};
+
+// Camera space, +z looks away from the camera. Returns false when nothing is left
+bool ClipSegmentDepth(vec3_t& a, vec3_t& b, float near_z, float far_z);
+
+// Sutherland-Hodgman against near/far, out needs room for count + 2 vertices. Returns the new count
+int ClipPolygonDepth(const vec3_t* in, int count, vec3_t* out, float near_z, float far_z);
+
+// Liang-Barsky against rect, returns false when the segment is fully outside or not finite
+bool ClipSegmentRect(vec2_t& a, vec2_t& b, const ClipRect& rect);
+
+// Sutherland-Hodgman against rect, out needs room for count + 4 vertices. Returns the new count
+int ClipPolygonRect(const vec2_t* in, int count, vec2_t* out, const ClipRect& rect);
@@ -0,0 +1,249 @@
+﻿#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "cpu_dispatch.hpp"
+#include "draw_kernels.hpp"
+
+#if CPU_DISPATCH_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+	void FillScalar(uint32_t* dst, size_t count, uint32_t color)
+	{
+		std::fill(dst, dst + count, color);
+	}
+
+	void BlendScalar(uint32_t* dst, size_t count, uint32_t color)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			dst[i] = BlendOver(color, dst[i]);
+		}
+	}
+
+	void BlendMaskScalar(uint32_t* dst, const uint8_t* coverage, size_t count, uint32_t color)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const uint32_t scaled = ScaleAlpha(color, coverage[i]);
+			if ((scaled >> 24) != 0)
+				dst[i] = BlendOver(scaled, dst[i]);
+		}
+	}
+
+	void ProjectScalar(const float* xs, const float* ys, const float* zs, size_t count,
+		const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			// Same near plane clamp as PerspectiveProject
+			float z = zs[i] - camera_position.z;
+			z = z <= near_plane ? near_plane : z;
+
+			float scale = fov_factor / z;
+			out[i].x = (xs[i] - camera_position.x) * scale;
+			out[i].y = (ys[i] - camera_position.y) * scale;
+		}
+	}
+
+	void ProjectQuantizedScalar(const uint16_t* xs, const uint16_t* ys, const uint16_t* zs, size_t count,
+		const vec3_t& origin, const vec3_t& step, const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			float z = (static_cast<float>(zs[i]) * step.z + origin.z) - camera_position.z;
+			z = z <= near_plane ? near_plane : z;
+
+			float scale = fov_factor / z;
+			out[i].x = ((static_cast<float>(xs[i]) * step.x + origin.x) - camera_position.x) * scale;
+			out[i].y = ((static_cast<float>(ys[i]) * step.y + origin.y) - camera_position.y) * scale;
+		}
+	}
+
+#if CPU_DISPATCH_X86
+	void ReadCpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+	{
+#ifdef _MSC_VER
+		int values[4];
+		__cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+		for (int i = 0; i < 4; ++i)
+			regs[i] = static_cast<uint32_t>(values[i]);
+#else
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	}
+
+	// Register state the OS saves on context switch, only valid when OSXSAVE is set
+	uint64_t ReadXcr0()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		uint32_t eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+	}
+#endif
+
+	CpuKernels BuildKernels(CpuPath path)
+	{
+		CpuKernels kernels = { CpuPath::Scalar, FillScalar, BlendScalar, BlendMaskScalar, ProjectScalar, ProjectQuantizedScalar };
+
+#if CPU_DISPATCH_X86
+		// Each level only replaces what it speeds up, the rest falls through from the level below
+		if (path >= CpuPath::SSE41) BindSSE41Kernels(kernels);
+		if (path >= CpuPath::AVX2) BindAVX2Kernels(kernels);
+		if (path >= CpuPath::AVX512) BindAVX512Kernels(kernels);
+		kernels.path = path;
+#endif
+
+		return kernels;
+	}
+
+	CpuPath GetStartupPath()
+	{
+		std::string name;
+
+#ifdef _MSC_VER
+		char* value = nullptr;
+		size_t length = 0;
+		if (_dupenv_s(&value, &length, "RENDERER_CPU_PATH") == 0 && value)
+		{
+			name = value;
+			free(value);
+		}
+#else
+		if (const char* value = std::getenv("RENDERER_CPU_PATH"))
+			name = value;
+#endif
+
+		const CpuPath detected = DetectCpuPath();
+		if (name.empty())
+			return detected;
+
+		CpuPath forced;
+		if (!ParseCpuPath(name.c_str(), forced))
+		{
+			std::cerr << "RENDERER_CPU_PATH: unknown path " << name << ", using " << GetCpuPathName(detected) << std::endl;
+			return detected;
+		}
+
+		if (!IsCpuPathSupported(forced))
+		{
+			std::cerr << "RENDERER_CPU_PATH: " << name << " is not supported here, using " << GetCpuPathName(detected) << std::endl;
+			return detected;
+		}
+
+		return forced;
+	}
+
+	CpuKernels& GetKernelTable()
+	{
+		static CpuKernels kernels = BuildKernels(GetStartupPath());
+		return kernels;
+	}
+}
+
+CpuPath DetectCpuPath()
+{
+#if CPU_DISPATCH_X86
+	uint32_t regs[4];
+	ReadCpuid(0, 0, regs);
+	const uint32_t max_leaf = regs[0];
+
+	if (max_leaf < 1)
+		return CpuPath::Scalar;
+
+	ReadCpuid(1, 0, regs);
+	const bool sse41 = (regs[2] & (1u << 19)) != 0;
+	const bool osxsave = (regs[2] & (1u << 27)) != 0;
+	const bool avx = (regs[2] & (1u << 28)) != 0;
+
+	if (!sse41)
+		return CpuPath::Scalar;
+
+	// The CPU supporting AVX is not enough, the OS has to save the wider registers too
+	const uint64_t xcr0 = osxsave ? ReadXcr0() : 0;
+	const bool ymm_state = (xcr0 & 0x6) == 0x6;
+	const bool zmm_state = (xcr0 & 0xE6) == 0xE6;
+
+	if (max_leaf < 7 || !avx || !ymm_state)
+		return CpuPath::SSE41;
+
+	ReadCpuid(7, 0, regs);
+	const bool avx2 = (regs[1] & (1u << 5)) != 0;
+	const bool avx512f = (regs[1] & (1u << 16)) != 0;
+	const bool avx512bw = (regs[1] & (1u << 30)) != 0;
+
+	if (!avx2)
+		return CpuPath::SSE41;
+
+	if (!avx512f || !avx512bw || !zmm_state)
+		return CpuPath::AVX2;
+
+	return CpuPath::AVX512;
+#else
+	return CpuPath::Scalar;
+#endif
+}
+
+bool IsCpuPathSupported(CpuPath path)
+{
+	return path <= DetectCpuPath();
+}
+
+bool SelectCpuPath(CpuPath path)
+{
+	if (!IsCpuPathSupported(path))
+	{
+		std::cerr << "CPU path " << GetCpuPathName(path) << " is not supported, keeping "
+			<< GetCpuPathName(GetKernelTable().path) << std::endl;
+		return false;
+	}
+
+	GetKernelTable() = BuildKernels(path);
+	return true;
+}
+
+const CpuKernels& GetCpuKernels()
+{
+	return GetKernelTable();
+}
+
+const char* GetCpuPathName(CpuPath path)
+{
+	switch (path)
+	{
+	case CpuPath::Scalar: return "scalar";
+	case CpuPath::SSE41: return "sse41";
+	case CpuPath::AVX2: return "avx2";
+	case CpuPath::AVX512: return "avx512";
+	}
+
+	return "unknown";
+}
+
+bool ParseCpuPath(const char* name, CpuPath& path)
+{
+	const CpuPath paths[] = { CpuPath::Scalar, CpuPath::SSE41, CpuPath::AVX2, CpuPath::AVX512 };
+
+	for (CpuPath candidate : paths)
+	{
+		if (std::strcmp(name, GetCpuPathName(candidate)) == 0)
+		{
+			path = candidate;
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,64 @@
+﻿#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#include "vector.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_DISPATCH_X86 1
+#endif
+
+// Instruction set paths, ordered from slowest to fastest
+enum class CpuPath : uint8_t
+{
+	Scalar,
+	SSE41,
+	AVX2,
+	AVX512		// AVX-512 F + BW
+};
+
+// Hot loops bound once to the best path the CPU and OS support. Every path gives bit identical results
+struct CpuKernels
+{
+	CpuPath path;
+
+	// dst[0, count) = color. Clears and opaque spans/rects/polygons
+	void (*fill)(uint32_t* dst, size_t count, uint32_t color);
+
+	// dst[i] = BlendOver(color, dst[i]). Alpha spans/rects/polygons
+	void (*blend)(uint32_t* dst, size_t count, uint32_t color);
+
+	// dst[i] = BlendOver(color with its alpha scaled by coverage[i], dst[i]), zero alpha pixels untouched. Text and masks
+	void (*blend_mask)(uint32_t* dst, const uint8_t* coverage, size_t count, uint32_t color);
+
+	// Perspective projection of structure of arrays points, see Projection::ProjectRange
+	void (*project)(const float* xs, const float* ys, const float* zs, size_t count,
+		const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out);
+
+	// project of 16-bit quantized points, dequantized in registers as q * step + origin (multiply, then add).
+	// Bit identical to project on the dequantized floats as long as the build does not contract them into FMAs
+	// (-ffp-contract=off when compiling everything with -mfma), see Projection::ProjectQuantizedRange
+	void (*project_quantized)(const uint16_t* xs, const uint16_t* ys, const uint16_t* zs, size_t count,
+		const vec3_t& origin, const vec3_t& step, const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out);
+};
+
+// Best path supported by this CPU and OS
+CpuPath DetectCpuPath();
+bool IsCpuPathSupported(CpuPath path);
+
+// Rebinds the table, for tests and forcing a path across a fleet. Refuses paths the CPU cannot run.
+// Not synchronized, call at startup before any rendering thread runs.
+// The initial path is DetectCpuPath() unless the RENDERER_CPU_PATH environment variable names another
+bool SelectCpuPath(CpuPath path);
+
+const CpuKernels& GetCpuKernels();
+
+const char* GetCpuPathName(CpuPath path);
+bool ParseCpuPath(const char* name, CpuPath& path);
+
+// Per path tables, defined in cpu_kernels_x86.cpp
+#if CPU_DISPATCH_X86
+void BindSSE41Kernels(CpuKernels& kernels);
+void BindAVX2Kernels(CpuKernels& kernels);
+void BindAVX512Kernels(CpuKernels& kernels);
+#endif
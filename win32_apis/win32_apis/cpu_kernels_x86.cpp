@@ -0,0 +1,608 @@
+﻿#include "cpu_dispatch.hpp"
+
+#if CPU_DISPATCH_X86
+#include <immintrin.h>
+
+#include "draw_kernels.hpp"
+
+// MSVC accepts any intrinsic without flags, GCC/Clang need the target per function.
+// Nothing here may run before DetectCpuPath said so
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CPU_TARGET(isa)
+#endif
+
+namespace
+{
+	// Scalar remainders, same math as the vector bodies
+	inline void BlendTail(uint32_t* dst, size_t count, uint32_t color)
+	{
+		for (size_t i = 0; i < count; ++i)
+			dst[i] = BlendOver(color, dst[i]);
+	}
+
+	inline void BlendMaskTail(uint32_t* dst, const uint8_t* coverage, size_t count, uint32_t color)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const uint32_t scaled = ScaleAlpha(color, coverage[i]);
+			if ((scaled >> 24) != 0)
+				dst[i] = BlendOver(scaled, dst[i]);
+		}
+	}
+
+	inline void ProjectTail(const float* xs, const float* ys, const float* zs, size_t count,
+		const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			float z = zs[i] - camera_position.z;
+			z = z <= near_plane ? near_plane : z;
+
+			float scale = fov_factor / z;
+			out[i].x = (xs[i] - camera_position.x) * scale;
+			out[i].y = (ys[i] - camera_position.y) * scale;
+		}
+	}
+
+	inline void ProjectQuantizedTail(const uint16_t* xs, const uint16_t* ys, const uint16_t* zs, size_t count,
+		const vec3_t& origin, const vec3_t& step, const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			float z = (static_cast<float>(zs[i]) * step.z + origin.z) - camera_position.z;
+			z = z <= near_plane ? near_plane : z;
+
+			float scale = fov_factor / z;
+			out[i].x = ((static_cast<float>(xs[i]) * step.x + origin.x) - camera_position.x) * scale;
+			out[i].y = ((static_cast<float>(ys[i]) * step.y + origin.y) - camera_position.y) * scale;
+		}
+	}
+
+	// Constant part of BlendOver per 16-bit channel: src * alpha for B, G, R, 0 for A
+	inline void GetBlendTerms(uint32_t color, int16_t terms[4], int16_t& inv_alpha)
+	{
+		const uint32_t alpha = (color >> 24) & 0xFF;
+		terms[0] = static_cast<int16_t>((color & 0xFF) * alpha);
+		terms[1] = static_cast<int16_t>(((color >> 8) & 0xFF) * alpha);
+		terms[2] = static_cast<int16_t>(((color >> 16) & 0xFF) * alpha);
+		terms[3] = 0;
+		inv_alpha = static_cast<int16_t>(255 - alpha);
+	}
+
+	// Unscaled source channels per 16-bit lane: B, G, R, 0
+	inline void GetMaskTerms(uint32_t color, int16_t terms[4])
+	{
+		terms[0] = static_cast<int16_t>(color & 0xFF);
+		terms[1] = static_cast<int16_t>((color >> 8) & 0xFF);
+		terms[2] = static_cast<int16_t>((color >> 16) & 0xFF);
+		terms[3] = 0;
+	}
+
+	// x / 255 for x <= 255 * 255 is exactly (x * 0x8081) >> 23, so results match the scalar division
+
+	// SSE4.1
+
+	CPU_TARGET("sse4.1")
+	void FillSSE41(uint32_t* dst, size_t count, uint32_t color)
+	{
+		size_t i = 0;
+		for (; i < count && (reinterpret_cast<uintptr_t>(dst + i) & 15) != 0; ++i)
+			dst[i] = color;
+
+		const __m128i value = _mm_set1_epi32(static_cast<int>(color));
+		for (; i + 4 <= count; i += 4)
+			_mm_store_si128(reinterpret_cast<__m128i*>(dst + i), value);
+
+		for (; i < count; ++i)
+			dst[i] = color;
+	}
+
+	CPU_TARGET("sse4.1")
+	void BlendSSE41(uint32_t* dst, size_t count, uint32_t color)
+	{
+		int16_t terms[4], inv_alpha;
+		GetBlendTerms(color, terms, inv_alpha);
+
+		const __m128i src = _mm_setr_epi16(terms[0], terms[1], terms[2], terms[3], terms[0], terms[1], terms[2], terms[3]);
+		const __m128i inv = _mm_set1_epi16(inv_alpha);
+		const __m128i div = _mm_set1_epi16(static_cast<int16_t>(0x8081));
+		const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000));
+		const __m128i zero = _mm_setzero_si128();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+			__m128i lo = _mm_cvtepu8_epi16(pixels);
+			__m128i hi = _mm_unpackhi_epi8(pixels, zero);
+
+			lo = _mm_add_epi16(_mm_mullo_epi16(lo, inv), src);
+			hi = _mm_add_epi16(_mm_mullo_epi16(hi, inv), src);
+			lo = _mm_srli_epi16(_mm_mulhi_epu16(lo, div), 7);
+			hi = _mm_srli_epi16(_mm_mulhi_epu16(hi, div), 7);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+		}
+
+		BlendTail(dst + i, count - i, color);
+	}
+
+	CPU_TARGET("sse4.1")
+	void BlendMaskSSE41(uint32_t* dst, const uint8_t* coverage, size_t count, uint32_t color)
+	{
+		int16_t terms[4];
+		GetMaskTerms(color, terms);
+
+		const __m128i src = _mm_setr_epi16(terms[0], terms[1], terms[2], terms[3], terms[0], terms[1], terms[2], terms[3]);
+		const __m128i alpha = _mm_set1_epi32(static_cast<int>((color >> 24) & 0xFF));
+		const __m128i div32 = _mm_set1_epi32(0x8081);
+		const __m128i div = _mm_set1_epi16(static_cast<int16_t>(0x8081));
+		const __m128i full = _mm_set1_epi16(255);
+		const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000));
+		const __m128i zero = _mm_setzero_si128();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			// Glyph gaps and margins are mostly empty, skip them without touching dst
+			uint32_t packed;
+			std::memcpy(&packed, coverage + i, sizeof(packed));
+			if (packed == 0)
+				continue;
+
+			// Per pixel alpha * coverage / 255 in 32-bit lanes, then copied to the pixel's four 16-bit channels
+			__m128i a = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(packed)));
+			a = _mm_srli_epi32(_mm_mullo_epi32(_mm_mullo_epi32(a, alpha), div32), 23);
+			const __m128i keep = _mm_cmpeq_epi32(a, zero);
+
+			a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+			const __m128i a_lo = _mm_unpacklo_epi32(a, a);
+			const __m128i a_hi = _mm_unpackhi_epi32(a, a);
+
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+			__m128i lo = _mm_cvtepu8_epi16(pixels);
+			__m128i hi = _mm_unpackhi_epi8(pixels, zero);
+
+			lo = _mm_add_epi16(_mm_mullo_epi16(lo, _mm_sub_epi16(full, a_lo)), _mm_mullo_epi16(src, a_lo));
+			hi = _mm_add_epi16(_mm_mullo_epi16(hi, _mm_sub_epi16(full, a_hi)), _mm_mullo_epi16(src, a_hi));
+			lo = _mm_srli_epi16(_mm_mulhi_epu16(lo, div), 7);
+			hi = _mm_srli_epi16(_mm_mulhi_epu16(hi, div), 7);
+
+			__m128i blended = _mm_or_si128(_mm_packus_epi16(lo, hi), opaque);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_blendv_epi8(blended, pixels, keep));
+		}
+
+		BlendMaskTail(dst + i, coverage + i, count - i, color);
+	}
+
+	CPU_TARGET("sse4.1")
+	void ProjectSSE41(const float* xs, const float* ys, const float* zs, size_t count,
+		const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out)
+	{
+		const __m128 cx = _mm_set1_ps(camera_position.x);
+		const __m128 cy = _mm_set1_ps(camera_position.y);
+		const __m128 cz = _mm_set1_ps(camera_position.z);
+		const __m128 fov = _mm_set1_ps(fov_factor);
+		const __m128 near_z = _mm_set1_ps(near_plane);
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			// max(near, z) keeps z for NaN like the scalar compare
+			__m128 z = _mm_max_ps(near_z, _mm_sub_ps(_mm_loadu_ps(zs + i), cz));
+			__m128 scale = _mm_div_ps(fov, z);
+			__m128 x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(xs + i), cx), scale);
+			__m128 y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(ys + i), cy), scale);
+
+			float* target = reinterpret_cast<float*>(out + i);
+			_mm_storeu_ps(target, _mm_unpacklo_ps(x, y));
+			_mm_storeu_ps(target + 4, _mm_unpackhi_ps(x, y));
+		}
+
+		ProjectTail(xs + i, ys + i, zs + i, count - i, camera_position, fov_factor, near_plane, out + i);
+	}
+
+	// Separate multiply and add, a fused multiply-add would round once and break bit equality with the scalar path
+	CPU_TARGET("sse4.1")
+	inline __m128 DequantizeSSE41(const uint16_t* values, __m128 step, __m128 origin)
+	{
+		__m128i q = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(values)));
+		return _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(q), step), origin);
+	}
+
+	CPU_TARGET("sse4.1")
+	void ProjectQuantizedSSE41(const uint16_t* xs, const uint16_t* ys, const uint16_t* zs, size_t count,
+		const vec3_t& origin, const vec3_t& step, const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out)
+	{
+		const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+		const __m128 sx = _mm_set1_ps(step.x), sy = _mm_set1_ps(step.y), sz = _mm_set1_ps(step.z);
+		const __m128 cx = _mm_set1_ps(camera_position.x);
+		const __m128 cy = _mm_set1_ps(camera_position.y);
+		const __m128 cz = _mm_set1_ps(camera_position.z);
+		const __m128 fov = _mm_set1_ps(fov_factor);
+		const __m128 near_z = _mm_set1_ps(near_plane);
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 z = _mm_max_ps(near_z, _mm_sub_ps(DequantizeSSE41(zs + i, sz, oz), cz));
+			__m128 scale = _mm_div_ps(fov, z);
+			__m128 x = _mm_mul_ps(_mm_sub_ps(DequantizeSSE41(xs + i, sx, ox), cx), scale);
+			__m128 y = _mm_mul_ps(_mm_sub_ps(DequantizeSSE41(ys + i, sy, oy), cy), scale);
+
+			float* target = reinterpret_cast<float*>(out + i);
+			_mm_storeu_ps(target, _mm_unpacklo_ps(x, y));
+			_mm_storeu_ps(target + 4, _mm_unpackhi_ps(x, y));
+		}
+
+		ProjectQuantizedTail(xs + i, ys + i, zs + i, count - i, origin, step, camera_position, fov_factor, near_plane, out + i);
+	}
+
+	// AVX2
+
+	CPU_TARGET("avx2")
+	void FillAVX2(uint32_t* dst, size_t count, uint32_t color)
+	{
+		size_t i = 0;
+		for (; i < count && (reinterpret_cast<uintptr_t>(dst + i) & 31) != 0; ++i)
+			dst[i] = color;
+
+		const __m256i value = _mm256_set1_epi32(static_cast<int>(color));
+		for (; i + 8 <= count; i += 8)
+			_mm256_store_si256(reinterpret_cast<__m256i*>(dst + i), value);
+
+		for (; i < count; ++i)
+			dst[i] = color;
+	}
+
+	CPU_TARGET("avx2")
+	void BlendAVX2(uint32_t* dst, size_t count, uint32_t color)
+	{
+		int16_t terms[4], inv_alpha;
+		GetBlendTerms(color, terms, inv_alpha);
+
+		const __m256i src = _mm256_setr_epi16(terms[0], terms[1], terms[2], terms[3], terms[0], terms[1], terms[2], terms[3],
+			terms[0], terms[1], terms[2], terms[3], terms[0], terms[1], terms[2], terms[3]);
+		const __m256i inv = _mm256_set1_epi16(inv_alpha);
+		const __m256i div = _mm256_set1_epi16(static_cast<int16_t>(0x8081));
+		const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+		const __m256i zero = _mm256_setzero_si256();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			// Unpack and pack both work per 128-bit lane, so pixel order survives the round trip
+			__m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+			__m256i lo = _mm256_unpacklo_epi8(pixels, zero);
+			__m256i hi = _mm256_unpackhi_epi8(pixels, zero);
+
+			lo = _mm256_add_epi16(_mm256_mullo_epi16(lo, inv), src);
+			hi = _mm256_add_epi16(_mm256_mullo_epi16(hi, inv), src);
+			lo = _mm256_srli_epi16(_mm256_mulhi_epu16(lo, div), 7);
+			hi = _mm256_srli_epi16(_mm256_mulhi_epu16(hi, div), 7);
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(_mm256_packus_epi16(lo, hi), opaque));
+		}
+
+		BlendSSE41(dst + i, count - i, color);
+	}
+
+	CPU_TARGET("avx2")
+	void BlendMaskAVX2(uint32_t* dst, const uint8_t* coverage, size_t count, uint32_t color)
+	{
+		int16_t terms[4];
+		GetMaskTerms(color, terms);
+
+		const __m256i src = _mm256_setr_epi16(terms[0], terms[1], terms[2], terms[3], terms[0], terms[1], terms[2], terms[3],
+			terms[0], terms[1], terms[2], terms[3], terms[0], terms[1], terms[2], terms[3]);
+		const __m256i alpha = _mm256_set1_epi32(static_cast<int>((color >> 24) & 0xFF));
+		const __m256i div32 = _mm256_set1_epi32(0x8081);
+		const __m256i div = _mm256_set1_epi16(static_cast<int16_t>(0x8081));
+		const __m256i full = _mm256_set1_epi16(255);
+		const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+		const __m256i zero = _mm256_setzero_si256();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			uint64_t packed;
+			std::memcpy(&packed, coverage + i, sizeof(packed));
+			if (packed == 0)
+				continue;
+
+			__m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(coverage + i)));
+			a = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_mullo_epi32(a, alpha), div32), 23);
+			const __m256i keep = _mm256_cmpeq_epi32(a, zero);
+
+			// Per lane like the pixel unpack below, so every alpha pairs with its own pixel
+			a = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+			const __m256i a_lo = _mm256_unpacklo_epi32(a, a);
+			const __m256i a_hi = _mm256_unpackhi_epi32(a, a);
+
+			__m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+			__m256i lo = _mm256_unpacklo_epi8(pixels, zero);
+			__m256i hi = _mm256_unpackhi_epi8(pixels, zero);
+
+			lo = _mm256_add_epi16(_mm256_mullo_epi16(lo, _mm256_sub_epi16(full, a_lo)), _mm256_mullo_epi16(src, a_lo));
+			hi = _mm256_add_epi16(_mm256_mullo_epi16(hi, _mm256_sub_epi16(full, a_hi)), _mm256_mullo_epi16(src, a_hi));
+			lo = _mm256_srli_epi16(_mm256_mulhi_epu16(lo, div), 7);
+			hi = _mm256_srli_epi16(_mm256_mulhi_epu16(hi, div), 7);
+
+			__m256i blended = _mm256_or_si256(_mm256_packus_epi16(lo, hi), opaque);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_blendv_epi8(blended, pixels, keep));
+		}
+
+		BlendMaskSSE41(dst + i, coverage + i, count - i, color);
+	}
+
+	CPU_TARGET("avx2")
+	void ProjectAVX2(const float* xs, const float* ys, const float* zs, size_t count,
+		const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out)
+	{
+		const __m256 cx = _mm256_set1_ps(camera_position.x);
+		const __m256 cy = _mm256_set1_ps(camera_position.y);
+		const __m256 cz = _mm256_set1_ps(camera_position.z);
+		const __m256 fov = _mm256_set1_ps(fov_factor);
+		const __m256 near_z = _mm256_set1_ps(near_plane);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 z = _mm256_max_ps(near_z, _mm256_sub_ps(_mm256_loadu_ps(zs + i), cz));
+			__m256 scale = _mm256_div_ps(fov, z);
+			__m256 x = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(xs + i), cx), scale);
+			__m256 y = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(ys + i), cy), scale);
+
+			// Per lane interleave gives points 0 1 4 5 / 2 3 6 7, swap the middle halves back
+			__m256 lo = _mm256_unpacklo_ps(x, y);
+			__m256 hi = _mm256_unpackhi_ps(x, y);
+
+			float* target = reinterpret_cast<float*>(out + i);
+			_mm256_storeu_ps(target, _mm256_permute2f128_ps(lo, hi, 0x20));
+			_mm256_storeu_ps(target + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+		}
+
+		ProjectSSE41(xs + i, ys + i, zs + i, count - i, camera_position, fov_factor, near_plane, out + i);
+	}
+
+	CPU_TARGET("avx2")
+	inline __m256 DequantizeAVX2(const uint16_t* values, __m256 step, __m256 origin)
+	{
+		__m256i q = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values)));
+		return _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(q), step), origin);
+	}
+
+	CPU_TARGET("avx2")
+	void ProjectQuantizedAVX2(const uint16_t* xs, const uint16_t* ys, const uint16_t* zs, size_t count,
+		const vec3_t& origin, const vec3_t& step, const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out)
+	{
+		const __m256 ox = _mm256_set1_ps(origin.x), oy = _mm256_set1_ps(origin.y), oz = _mm256_set1_ps(origin.z);
+		const __m256 sx = _mm256_set1_ps(step.x), sy = _mm256_set1_ps(step.y), sz = _mm256_set1_ps(step.z);
+		const __m256 cx = _mm256_set1_ps(camera_position.x);
+		const __m256 cy = _mm256_set1_ps(camera_position.y);
+		const __m256 cz = _mm256_set1_ps(camera_position.z);
+		const __m256 fov = _mm256_set1_ps(fov_factor);
+		const __m256 near_z = _mm256_set1_ps(near_plane);
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 z = _mm256_max_ps(near_z, _mm256_sub_ps(DequantizeAVX2(zs + i, sz, oz), cz));
+			__m256 scale = _mm256_div_ps(fov, z);
+			__m256 x = _mm256_mul_ps(_mm256_sub_ps(DequantizeAVX2(xs + i, sx, ox), cx), scale);
+			__m256 y = _mm256_mul_ps(_mm256_sub_ps(DequantizeAVX2(ys + i, sy, oy), cy), scale);
+
+			__m256 lo = _mm256_unpacklo_ps(x, y);
+			__m256 hi = _mm256_unpackhi_ps(x, y);
+
+			float* target = reinterpret_cast<float*>(out + i);
+			_mm256_storeu_ps(target, _mm256_permute2f128_ps(lo, hi, 0x20));
+			_mm256_storeu_ps(target + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+		}
+
+		ProjectQuantizedSSE41(xs + i, ys + i, zs + i, count - i, origin, step, camera_position, fov_factor, near_plane, out + i);
+	}
+
+	// AVX-512 F + BW
+
+	CPU_TARGET("avx512f")
+	void FillAVX512(uint32_t* dst, size_t count, uint32_t color)
+	{
+		size_t i = 0;
+		for (; i < count && (reinterpret_cast<uintptr_t>(dst + i) & 63) != 0; ++i)
+			dst[i] = color;
+
+		const __m512i value = _mm512_set1_epi32(static_cast<int>(color));
+		for (; i + 16 <= count; i += 16)
+			_mm512_store_si512(reinterpret_cast<void*>(dst + i), value);
+
+		for (; i < count; ++i)
+			dst[i] = color;
+	}
+
+	CPU_TARGET("avx512f,avx512bw")
+	void BlendAVX512(uint32_t* dst, size_t count, uint32_t color)
+	{
+		int16_t terms[4], inv_alpha;
+		GetBlendTerms(color, terms, inv_alpha);
+
+		const uint64_t pattern = static_cast<uint16_t>(terms[0]) | (static_cast<uint64_t>(static_cast<uint16_t>(terms[1])) << 16) |
+			(static_cast<uint64_t>(static_cast<uint16_t>(terms[2])) << 32);
+		const __m512i src = _mm512_set1_epi64(static_cast<long long>(pattern));
+		const __m512i inv = _mm512_set1_epi16(inv_alpha);
+		const __m512i div = _mm512_set1_epi16(static_cast<int16_t>(0x8081));
+		const __m512i opaque = _mm512_set1_epi32(static_cast<int>(0xFF000000));
+		const __m512i zero = _mm512_setzero_si512();
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			__m512i pixels = _mm512_loadu_si512(reinterpret_cast<const void*>(dst + i));
+			__m512i lo = _mm512_unpacklo_epi8(pixels, zero);
+			__m512i hi = _mm512_unpackhi_epi8(pixels, zero);
+
+			lo = _mm512_add_epi16(_mm512_mullo_epi16(lo, inv), src);
+			hi = _mm512_add_epi16(_mm512_mullo_epi16(hi, inv), src);
+			lo = _mm512_srli_epi16(_mm512_mulhi_epu16(lo, div), 7);
+			hi = _mm512_srli_epi16(_mm512_mulhi_epu16(hi, div), 7);
+
+			_mm512_storeu_si512(reinterpret_cast<void*>(dst + i), _mm512_or_si512(_mm512_packus_epi16(lo, hi), opaque));
+		}
+
+		BlendAVX2(dst + i, count - i, color);
+	}
+
+	CPU_TARGET("avx512f,avx512bw")
+	void BlendMaskAVX512(uint32_t* dst, const uint8_t* coverage, size_t count, uint32_t color)
+	{
+		int16_t terms[4];
+		GetMaskTerms(color, terms);
+
+		const uint64_t pattern = static_cast<uint16_t>(terms[0]) | (static_cast<uint64_t>(static_cast<uint16_t>(terms[1])) << 16) |
+			(static_cast<uint64_t>(static_cast<uint16_t>(terms[2])) << 32);
+		const __m512i src = _mm512_set1_epi64(static_cast<long long>(pattern));
+		const __m512i alpha = _mm512_set1_epi32(static_cast<int>((color >> 24) & 0xFF));
+		const __m512i div32 = _mm512_set1_epi32(0x8081);
+		const __m512i div = _mm512_set1_epi16(static_cast<int16_t>(0x8081));
+		const __m512i full = _mm512_set1_epi16(255);
+		const __m512i opaque = _mm512_set1_epi32(static_cast<int>(0xFF000000));
+		const __m512i zero = _mm512_setzero_si512();
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coverage + i));
+			if (_mm_testz_si128(packed, packed))
+				continue;
+
+			__m512i a = _mm512_cvtepu8_epi32(packed);
+			a = _mm512_srli_epi32(_mm512_mullo_epi32(_mm512_mullo_epi32(a, alpha), div32), 23);
+			const __mmask16 keep = _mm512_cmpeq_epi32_mask(a, zero);
+
+			a = _mm512_or_si512(a, _mm512_slli_epi32(a, 16));
+			const __m512i a_lo = _mm512_unpacklo_epi32(a, a);
+			const __m512i a_hi = _mm512_unpackhi_epi32(a, a);
+
+			__m512i pixels = _mm512_loadu_si512(reinterpret_cast<const void*>(dst + i));
+			__m512i lo = _mm512_unpacklo_epi8(pixels, zero);
+			__m512i hi = _mm512_unpackhi_epi8(pixels, zero);
+
+			lo = _mm512_add_epi16(_mm512_mullo_epi16(lo, _mm512_sub_epi16(full, a_lo)), _mm512_mullo_epi16(src, a_lo));
+			hi = _mm512_add_epi16(_mm512_mullo_epi16(hi, _mm512_sub_epi16(full, a_hi)), _mm512_mullo_epi16(src, a_hi));
+			lo = _mm512_srli_epi16(_mm512_mulhi_epu16(lo, div), 7);
+			hi = _mm512_srli_epi16(_mm512_mulhi_epu16(hi, div), 7);
+
+			__m512i blended = _mm512_or_si512(_mm512_packus_epi16(lo, hi), opaque);
+			_mm512_storeu_si512(reinterpret_cast<void*>(dst + i), _mm512_mask_blend_epi32(keep, blended, pixels));
+		}
+
+		BlendMaskAVX2(dst + i, coverage + i, count - i, color);
+	}
+
+	CPU_TARGET("avx512f")
+	void ProjectAVX512(const float* xs, const float* ys, const float* zs, size_t count,
+		const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out)
+	{
+		const __m512 cx = _mm512_set1_ps(camera_position.x);
+		const __m512 cy = _mm512_set1_ps(camera_position.y);
+		const __m512 cz = _mm512_set1_ps(camera_position.z);
+		const __m512 fov = _mm512_set1_ps(fov_factor);
+		const __m512 near_z = _mm512_set1_ps(near_plane);
+
+		// Element indices into (lo, hi), lo = 0..15, hi = 16..31
+		const __m512i first = _mm512_setr_epi32(0, 1, 2, 3, 16, 17, 18, 19, 4, 5, 6, 7, 20, 21, 22, 23);
+		const __m512i second = _mm512_setr_epi32(8, 9, 10, 11, 24, 25, 26, 27, 12, 13, 14, 15, 28, 29, 30, 31);
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			__m512 z = _mm512_max_ps(near_z, _mm512_sub_ps(_mm512_loadu_ps(zs + i), cz));
+			__m512 scale = _mm512_div_ps(fov, z);
+			__m512 x = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(xs + i), cx), scale);
+			__m512 y = _mm512_mul_ps(_mm512_sub_ps(_mm512_loadu_ps(ys + i), cy), scale);
+
+			__m512 lo = _mm512_unpacklo_ps(x, y);
+			__m512 hi = _mm512_unpackhi_ps(x, y);
+
+			float* target = reinterpret_cast<float*>(out + i);
+			_mm512_storeu_ps(target, _mm512_permutex2var_ps(lo, first, hi));
+			_mm512_storeu_ps(target + 16, _mm512_permutex2var_ps(lo, second, hi));
+		}
+
+		ProjectAVX2(xs + i, ys + i, zs + i, count - i, camera_position, fov_factor, near_plane, out + i);
+	}
+
+	// AVX-512 implies FMA, so compilers may fuse a plain multiply and add. Explicit rounding operands keep them apart
+	CPU_TARGET("avx512f")
+	inline __m512 DequantizeAVX512(const uint16_t* values, __m512 step, __m512 origin)
+	{
+		__m512i q = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values)));
+		__m512 scaled = _mm512_mul_round_ps(_mm512_cvtepi32_ps(q), step, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		return _mm512_add_round_ps(scaled, origin, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	}
+
+	CPU_TARGET("avx512f")
+	void ProjectQuantizedAVX512(const uint16_t* xs, const uint16_t* ys, const uint16_t* zs, size_t count,
+		const vec3_t& origin, const vec3_t& step, const vec3_t& camera_position, float fov_factor, float near_plane, vec2_t* out)
+	{
+		const __m512 ox = _mm512_set1_ps(origin.x), oy = _mm512_set1_ps(origin.y), oz = _mm512_set1_ps(origin.z);
+		const __m512 sx = _mm512_set1_ps(step.x), sy = _mm512_set1_ps(step.y), sz = _mm512_set1_ps(step.z);
+		const __m512 cx = _mm512_set1_ps(camera_position.x);
+		const __m512 cy = _mm512_set1_ps(camera_position.y);
+		const __m512 cz = _mm512_set1_ps(camera_position.z);
+		const __m512 fov = _mm512_set1_ps(fov_factor);
+		const __m512 near_z = _mm512_set1_ps(near_plane);
+
+		const __m512i first = _mm512_setr_epi32(0, 1, 2, 3, 16, 17, 18, 19, 4, 5, 6, 7, 20, 21, 22, 23);
+		const __m512i second = _mm512_setr_epi32(8, 9, 10, 11, 24, 25, 26, 27, 12, 13, 14, 15, 28, 29, 30, 31);
+
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16)
+		{
+			__m512 z = _mm512_max_ps(near_z, _mm512_sub_ps(DequantizeAVX512(zs + i, sz, oz), cz));
+			__m512 scale = _mm512_div_ps(fov, z);
+			__m512 x = _mm512_mul_ps(_mm512_sub_ps(DequantizeAVX512(xs + i, sx, ox), cx), scale);
+			__m512 y = _mm512_mul_ps(_mm512_sub_ps(DequantizeAVX512(ys + i, sy, oy), cy), scale);
+
+			__m512 lo = _mm512_unpacklo_ps(x, y);
+			__m512 hi = _mm512_unpackhi_ps(x, y);
+
+			float* target = reinterpret_cast<float*>(out + i);
+			_mm512_storeu_ps(target, _mm512_permutex2var_ps(lo, first, hi));
+			_mm512_storeu_ps(target + 16, _mm512_permutex2var_ps(lo, second, hi));
+		}
+
+		ProjectQuantizedAVX2(xs + i, ys + i, zs + i, count - i, origin, step, camera_position, fov_factor, near_plane, out + i);
+	}
+}
+
+void BindSSE41Kernels(CpuKernels& kernels)
+{
+	kernels.fill = FillSSE41;
+	kernels.blend = BlendSSE41;
+	kernels.blend_mask = BlendMaskSSE41;
+	kernels.project = ProjectSSE41;
+	kernels.project_quantized = ProjectQuantizedSSE41;
+}
+
+void BindAVX2Kernels(CpuKernels& kernels)
+{
+	kernels.fill = FillAVX2;
+	kernels.blend = BlendAVX2;
+	kernels.blend_mask = BlendMaskAVX2;
+	kernels.project = ProjectAVX2;
+	kernels.project_quantized = ProjectQuantizedAVX2;
+}
+
+void BindAVX512Kernels(CpuKernels& kernels)
+{
+	kernels.fill = FillAVX512;
+	kernels.blend = BlendAVX512;
+	kernels.blend_mask = BlendMaskAVX512;
+	kernels.project = ProjectAVX512;
+	kernels.project_quantized = ProjectQuantizedAVX512;
+}
+
+#endif
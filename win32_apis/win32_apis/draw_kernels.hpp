@@ -0,0 +1,458 @@
+﻿#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+
+#include "pixel_format.hpp"
+#include "cpu_dispatch.hpp"
+#include "perf_counters.hpp"
+#include "vector.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define DRAW_KERNELS_SSE2 1
+#endif
+
+enum class BlendMode : uint8_t
+{
+	Opaque,		// Replace dst, source alpha ignored
+	Alpha		// Normal / Over blending
+};
+
+enum class ClipMode : uint8_t
+{
+	Clip,		// Clip against the view bounds
+	None		// Caller guarantees everything is inside the view
+};
+
+// Normal / Over blending of src onto an opaque dst, both 0xAARRGGBB
+inline uint32_t BlendOver(uint32_t color, uint32_t dst)
+{
+	// Extract ARGB components
+	// 0xAARRGGBB >> 24 = 0x000000AA
+	uint8_t src_a = (color >> 24) & 0xFF;
+	// 0xAARRGGBB >> 16 = 0x0000AARR
+	uint8_t src_r = (color >> 16) & 0xFF;
+	// 0xAARRGGBB >> 8 = 0x00AARRGG
+	uint8_t src_g = (color >> 8) & 0xFF;
+	// 0xAARRGGBB >> 0xAARRGGBB
+	uint8_t src_b = color & 0xFF;
+
+	uint8_t dst_r = (dst >> 16) & 0xFF;
+	uint8_t dst_g = (dst >> 8) & 0xFF;
+	uint8_t dst_b = dst & 0xFF;
+
+	uint8_t inv_alpha = 255 - src_a;
+	uint8_t final_r = (src_r * src_a + dst_r * inv_alpha) / 255; // <-- Divided by 255 to be normalized
+	uint8_t final_g = (src_g * src_a + dst_g * inv_alpha) / 255;
+	uint8_t final_b = (src_b * src_a + dst_b * inv_alpha) / 255;
+
+	return 0xFF000000 | (final_r << 16) | (final_g << 8) | final_b;
+}
+
+// Generic path: alpha is inspected per pixel (opaque, blend or skip)
+template<typename View>
+inline void PlotPixelKernel(const View& view, int x, int y, uint32_t color)
+{
+	typedef typename View::format_t Format;
+
+	if (x < 0 || x >= view.width || y < 0 || y >= view.height)
+		return;
+
+	typename View::pixel_t* pixel = view.At(x, y);
+	uint8_t src_a = (color >> 24) & 0xFF;
+
+	if (src_a == 255) {
+		// Fully opaque - just replace
+		*pixel = Format::Encode(color);
+	}
+	else if (src_a > 0) {
+		// Alpha blend manually
+		*pixel = Format::Encode(BlendOver(color, Format::Decode(*pixel)));
+	}
+	// If src_a == 0, don't draw anything
+}
+
+template<BlendMode Mode, ClipMode Clip, typename View>
+inline void PutPixelKernel(const View& view, int x, int y, uint32_t color)
+{
+	typedef typename View::format_t Format;
+
+	if constexpr (Clip == ClipMode::Clip)
+	{
+		if (x < 0 || x >= view.width || y < 0 || y >= view.height)
+			return;
+	}
+
+	typename View::pixel_t* pixel = view.At(x, y);
+
+	if constexpr (Mode == BlendMode::Opaque)
+		*pixel = Format::Encode(color);
+	else
+		*pixel = Format::Encode(BlendOver(color, Format::Decode(*pixel)));
+}
+
+// Horizontal run of length pixels starting at (x, y)
+template<BlendMode Mode, ClipMode Clip, typename View>
+inline void FillSpanKernel(const View& view, int x, int y, int length, uint32_t color)
+{
+	typedef typename View::format_t Format;
+	typedef typename View::pixel_t pixel_t;
+
+	if constexpr (Clip == ClipMode::Clip)
+	{
+		if (y < 0 || y >= view.height)
+			return;
+
+		int x_end = std::min(x + length, view.width);
+		x = std::max(x, 0);
+		length = x_end - x;
+	}
+
+	if (length <= 0)
+		return;
+
+	PerfCounters::Add(PerfCounter::PixelsFilled, static_cast<uint64_t>(length));
+
+	if constexpr (Format::format == PixelFormat::ARGB8888)
+	{
+		// 32-bit runs go through the CPU dispatch table (SSE4.1 / AVX2 / AVX-512)
+		const CpuKernels& kernels = GetCpuKernels();
+
+		while (length > 0)
+		{
+			int run = length;
+			if constexpr (View::layout_t::layout == FramebufferLayout::Tiled)
+				run = std::min(length, FRAMEBUFFER_TILE_SIZE - (x & (FRAMEBUFFER_TILE_SIZE - 1)));
+
+			if constexpr (Mode == BlendMode::Opaque)
+				kernels.fill(view.At(x, y), run, color);
+			else
+				kernels.blend(view.At(x, y), run, color);
+
+			x += run;
+			length -= run;
+		}
+	}
+	else if constexpr (Mode == BlendMode::Opaque)
+	{
+		const pixel_t encoded = Format::Encode(color);
+
+		if constexpr (View::layout_t::layout == FramebufferLayout::Linear)
+		{
+			std::fill_n(view.At(x, y), length, encoded);
+		}
+		else
+		{
+			// Contiguous only inside a tile row
+			while (length > 0)
+			{
+				int run = std::min(length, FRAMEBUFFER_TILE_SIZE - (x & (FRAMEBUFFER_TILE_SIZE - 1)));
+				std::fill_n(view.At(x, y), run, encoded);
+				x += run;
+				length -= run;
+			}
+		}
+	}
+	else
+	{
+		for (int i = 0; i < length; ++i)
+		{
+			pixel_t* pixel = view.At(x + i, y);
+			*pixel = Format::Encode(BlendOver(color, Format::Decode(*pixel)));
+		}
+	}
+}
+
+template<BlendMode Mode, ClipMode Clip, typename View>
+inline void FillRectKernel(const View& view, int x, int y, int width, int height, uint32_t color)
+{
+	if constexpr (Clip == ClipMode::Clip)
+	{
+		int x_end = std::min(x + width, view.width);
+		int y_end = std::min(y + height, view.height);
+		x = std::max(x, 0);
+		y = std::max(y, 0);
+		width = x_end - x;
+		height = y_end - y;
+	}
+
+	if (width <= 0 || height <= 0)
+		return;
+
+	// Rect is fully inside now, rows need no further checks
+	for (int row = y; row < y + height; ++row)
+	{
+		FillSpanKernel<Mode, ClipMode::None>(view, x, row, width, color);
+	}
+}
+
+// Convex polygon, sampled at pixel centers. Vertices must already be inside the guard band,
+// rows and spans are clamped to the view so no pixel is ever bounds checked
+template<BlendMode Mode, typename View>
+inline void FillConvexPolygonKernel(const View& view, const vec2_t* points, int count, uint32_t color)
+{
+	if (count < 3)
+		return;
+
+	float min_y = points[0].y;
+	float max_y = points[0].y;
+	for (int i = 1; i < count; ++i)
+	{
+		min_y = std::min(min_y, points[i].y);
+		max_y = std::max(max_y, points[i].y);
+	}
+
+	int y_start = std::max(0, static_cast<int>(std::ceil(min_y - 0.5f)));
+	int y_end = std::min(view.height, static_cast<int>(std::ceil(max_y - 0.5f)));
+
+	for (int y = y_start; y < y_end; ++y)
+	{
+		float sample_y = y + 0.5f;
+		float left = FLT_MAX;
+		float right = -FLT_MAX;
+
+		for (int i = 0; i < count; ++i)
+		{
+			const vec2_t& a = points[i];
+			const vec2_t& b = points[(i + 1) % count];
+
+			// Half open so shared edges are not filled twice
+			if ((a.y <= sample_y) == (b.y <= sample_y))
+				continue;
+
+			float x = a.x + (sample_y - a.y) * (b.x - a.x) / (b.y - a.y);
+			left = std::min(left, x);
+			right = std::max(right, x);
+		}
+
+		if (left > right)
+			continue;
+
+		int x_start = std::max(0, static_cast<int>(std::ceil(left - 0.5f)));
+		int x_end = std::min(view.width, static_cast<int>(std::ceil(right - 0.5f)));
+
+		FillSpanKernel<Mode, ClipMode::None>(view, x_start, y, x_end - x_start, color);
+	}
+}
+
+// Integer Bresenham, both endpoints must be inside the view
+template<BlendMode Mode, typename View>
+inline void DrawLineKernel(const View& view, int x0, int y0, int x1, int y1, uint32_t color)
+{
+	if (y0 == y1)
+	{
+		FillSpanKernel<Mode, ClipMode::None>(view, std::min(x0, x1), y0, std::abs(x1 - x0) + 1, color);
+		return;
+	}
+
+	const int dx = std::abs(x1 - x0);
+	const int dy = -std::abs(y1 - y0);
+	const int step_x = x0 < x1 ? 1 : -1;
+	const int step_y = y0 < y1 ? 1 : -1;
+	int error = dx + dy;
+
+	for (;;)
+	{
+		PutPixelKernel<Mode, ClipMode::None>(view, x0, y0, color);
+
+		if (x0 == x1 && y0 == y1)
+			break;
+
+		int error2 = 2 * error;
+		if (error2 >= dy) { error += dy; x0 += step_x; }
+		if (error2 <= dx) { error += dx; y0 += step_y; }
+	}
+}
+
+// Xiaolin Wu anti-aliased line, coverage scales the source alpha.
+// Both endpoints must lie in [1, width - 2] x [1, height - 2]: the pixel pair straddling the ideal line
+// then stays inside the view, so nothing is bounds checked per pixel
+template<typename View>
+inline void DrawLineAAKernel(const View& view, float x0, float y0, float x1, float y1, uint32_t color)
+{
+	const uint32_t src_a = (color >> 24) & 0xFF;
+	const uint32_t rgb = color & 0x00FFFFFF;
+
+	auto plot = [&](int x, int y, float coverage)
+	{
+		uint32_t a = static_cast<uint32_t>(src_a * coverage + 0.5f);
+		if (a > 0)
+			PutPixelKernel<BlendMode::Alpha, ClipMode::None>(view, x, y, (a << 24) | rgb);
+	};
+
+	const bool steep = std::fabs(y1 - y0) > std::fabs(x1 - x0);
+	if (steep) { std::swap(x0, y0); std::swap(x1, y1); }
+	if (x0 > x1) { std::swap(x0, x1); std::swap(y0, y1); }
+
+	const float dx = x1 - x0;
+	const float gradient = dx == 0.0f ? 1.0f : (y1 - y0) / dx;
+
+	int x_start = static_cast<int>(std::floor(x0 + 0.5f));
+	int x_end = static_cast<int>(std::floor(x1 + 0.5f));
+
+	for (int x = x_start; x <= x_end; ++x)
+	{
+		// Evaluated per column instead of accumulated, so long lines cannot drift past the one pixel margin
+		float y = y0 + gradient * (x - x0);
+		int y_floor = static_cast<int>(std::floor(y));
+		float fraction = y - y_floor;
+
+		if (steep)
+		{
+			plot(y_floor, x, 1.0f - fraction);
+			plot(y_floor + 1, x, fraction);
+		}
+		else
+		{
+			plot(x, y_floor, 1.0f - fraction);
+			plot(x, y_floor + 1, fraction);
+		}
+	}
+}
+
+// Part of an 8-bit coverage image placed relative to a draw origin, e.g. one glyph of a GlyphAtlas.
+// The placement is 32-bit so a long or many-line label never wraps around
+struct AlphaMaskRect
+{
+	int32_t x;
+	int32_t y;
+	uint16_t src_x;
+	uint16_t src_y;
+	uint16_t width;
+	uint16_t height;
+};
+
+// Source alpha scaled by coverage, divided exactly like BlendOver
+inline uint32_t ScaleAlpha(uint32_t color, uint8_t coverage)
+{
+	const uint32_t alpha = (((color >> 24) & 0xFF) * coverage) / 255;
+	return (alpha << 24) | (color & 0x00FFFFFF);
+}
+
+// Blends color through length coverage values starting at (x, y), the run must be inside the view.
+// Pixels whose scaled alpha is 0 are left untouched
+template<typename View>
+inline void BlendMaskSpanKernel(const View& view, int x, int y, const uint8_t* coverage, int length, uint32_t color)
+{
+	typedef typename View::format_t Format;
+
+	PerfCounters::Add(PerfCounter::PixelsFilled, static_cast<uint64_t>(length));
+
+	if constexpr (Format::format == PixelFormat::ARGB8888)
+	{
+		const CpuKernels& kernels = GetCpuKernels();
+
+		while (length > 0)
+		{
+			int run = length;
+			if constexpr (View::layout_t::layout == FramebufferLayout::Tiled)
+				run = std::min(length, FRAMEBUFFER_TILE_SIZE - (x & (FRAMEBUFFER_TILE_SIZE - 1)));
+
+			kernels.blend_mask(view.At(x, y), coverage, run, color);
+
+			x += run;
+			coverage += run;
+			length -= run;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < length; ++i)
+		{
+			const uint32_t scaled = ScaleAlpha(color, coverage[i]);
+			if ((scaled >> 24) == 0)
+				continue;
+
+			typename View::pixel_t* pixel = view.At(x + i, y);
+			*pixel = Format::Encode(BlendOver(scaled, Format::Decode(*pixel)));
+		}
+	}
+}
+
+// Batch of mask rects drawn at (x, y), every rect is clipped to the view on its own
+template<typename View>
+inline void BlendAlphaMasksKernel(const View& view, int x, int y, const uint8_t* mask, int mask_stride,
+	const AlphaMaskRect* rects, size_t count, uint32_t color)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		const AlphaMaskRect& rect = rects[i];
+		const int left = x + rect.x;
+		const int top = y + rect.y;
+
+		const int x0 = std::max(left, 0);
+		const int y0 = std::max(top, 0);
+		const int x1 = std::min(left + static_cast<int>(rect.width), view.width);
+		const int y1 = std::min(top + static_cast<int>(rect.height), view.height);
+		if (x0 >= x1 || y0 >= y1)
+			continue;
+
+		const uint8_t* source = mask + static_cast<size_t>(rect.src_y + (y0 - top)) * mask_stride + rect.src_x + (x0 - left);
+		for (int row = y0; row < y1; ++row, source += mask_stride)
+		{
+			BlendMaskSpanKernel(view, x0, row, source, x1 - x0, color);
+		}
+	}
+}
+
+// Copies a rect of the view out as 0xAARRGGBB rows, rect must be inside the view
+template<typename View>
+inline void ReadTileKernel(const View& view, int x, int y, int width, int height, uint32_t* pixels, int stride)
+{
+	typedef typename View::format_t Format;
+
+	for (int row = 0; row < height; ++row)
+	{
+		uint32_t* dst = pixels + static_cast<size_t>(row) * stride;
+		for (int col = 0; col < width; ++col)
+		{
+			dst[col] = Format::Decode(*view.At(x + col, y + row));
+		}
+	}
+}
+
+// Writes 0xAARRGGBB rows into a rect of the view, rect must be inside the view.
+// Linear ARGB rows use non-temporal stores so finished tiles do not evict the working set
+template<typename View>
+inline void WriteTileKernel(const View& view, int x, int y, int width, int height, const uint32_t* pixels, int stride)
+{
+	typedef typename View::format_t Format;
+
+	for (int row = 0; row < height; ++row)
+	{
+		const uint32_t* src = pixels + static_cast<size_t>(row) * stride;
+
+		if constexpr (Format::format == PixelFormat::ARGB8888 && View::layout_t::layout == FramebufferLayout::Linear)
+		{
+			uint32_t* dst = view.At(x, y + row);
+			int col = 0;
+
+#if DRAW_KERNELS_SSE2
+			// Scalar head up to 16 byte alignment, then 4 pixels per store
+			for (; col < width && (reinterpret_cast<uintptr_t>(dst + col) & 15) != 0; ++col)
+				dst[col] = src[col];
+
+			for (; col + 4 <= width; col += 4)
+				_mm_stream_si128(reinterpret_cast<__m128i*>(dst + col), _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + col)));
+#endif
+			for (; col < width; ++col)
+				dst[col] = src[col];
+		}
+		else
+		{
+			for (int col = 0; col < width; ++col)
+			{
+				*view.At(x + col, y + row) = Format::Encode(src[col]);
+			}
+		}
+	}
+
+#if DRAW_KERNELS_SSE2
+	// Make the streamed rows visible before anyone presents the buffer
+	_mm_sfence();
+#endif
+}
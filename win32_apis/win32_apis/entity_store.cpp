@@ -0,0 +1,248 @@
+﻿#include <algorithm>
+
+#include "entity_store.hpp"
+
+std::atomic<uint64_t> EntityStore::s_next_version(0);
+
+namespace
+{
+	inline bool IsMoving(const vec3_t& velocity)
+	{
+		return velocity.x != 0.0f || velocity.y != 0.0f || velocity.z != 0.0f;
+	}
+}
+
+uint32_t EntityStore::Create(const vec3_t& position, const vec3_t& velocity)
+{
+	uint32_t id = static_cast<uint32_t>(m_pos_x.size());
+
+	if (id % ENTITY_CHUNK_SIZE == 0)
+		m_chunks.emplace_back();
+
+	m_pos_x.push_back(position.x);
+	m_pos_y.push_back(position.y);
+	m_pos_z.push_back(position.z);
+
+	m_vel_x.push_back(velocity.x);
+	m_vel_y.push_back(velocity.y);
+	m_vel_z.push_back(velocity.z);
+
+	if (IsMoving(velocity))
+		m_chunks.back().moving++;
+	m_chunks.back().version = NextVersion();
+
+	return id;
+}
+
+void EntityStore::Reserve(size_t count)
+{
+	m_pos_x.reserve(count);
+	m_pos_y.reserve(count);
+	m_pos_z.reserve(count);
+	m_vel_x.reserve(count);
+	m_vel_y.reserve(count);
+	m_vel_z.reserve(count);
+	m_chunks.reserve((count + ENTITY_CHUNK_SIZE - 1) / ENTITY_CHUNK_SIZE);
+}
+
+void EntityStore::Clear()
+{
+	m_pos_x.clear();
+	m_pos_y.clear();
+	m_pos_z.clear();
+	m_vel_x.clear();
+	m_vel_y.clear();
+	m_vel_z.clear();
+	m_chunks.clear();
+}
+
+void EntityStore::SetPosition(uint32_t id, const vec3_t& position)
+{
+	if (id >= GetCount())
+		return;
+
+	m_pos_x[id] = position.x;
+	m_pos_y[id] = position.y;
+	m_pos_z[id] = position.z;
+	MarkDirty(id);
+}
+
+void EntityStore::SetVelocity(uint32_t id, const vec3_t& velocity)
+{
+	if (id >= GetCount())
+		return;
+
+	bool was_moving = IsMoving(vec3_t(m_vel_x[id], m_vel_y[id], m_vel_z[id]));
+	bool is_moving = IsMoving(velocity);
+
+	ChunkState& chunk = m_chunks[id / ENTITY_CHUNK_SIZE];
+	if (is_moving && !was_moving) chunk.moving++;
+	if (!is_moving && was_moving) chunk.moving--;
+
+	m_vel_x[id] = velocity.x;
+	m_vel_y[id] = velocity.y;
+	m_vel_z[id] = velocity.z;
+}
+
+void EntityStore::Integrate(JobSystem& jobs, float dt)
+{
+	const size_t count = GetCount();
+
+	jobs.ParallelFor(count, ENTITY_CHUNK_SIZE, [this, dt](size_t begin, size_t end)
+	{
+		ChunkState& chunk = m_chunks[begin / ENTITY_CHUNK_SIZE];
+		if (chunk.moving == 0)
+			return;
+
+		// Separate axis loops over contiguous floats, the compiler vectorizes these
+		float* px = m_pos_x.data();
+		float* py = m_pos_y.data();
+		float* pz = m_pos_z.data();
+		const float* vx = m_vel_x.data();
+		const float* vy = m_vel_y.data();
+		const float* vz = m_vel_z.data();
+
+		for (size_t i = begin; i < end; ++i) px[i] += vx[i] * dt;
+		for (size_t i = begin; i < end; ++i) py[i] += vy[i] * dt;
+		for (size_t i = begin; i < end; ++i) pz[i] += vz[i] * dt;
+
+		chunk.version = NextVersion();
+	});
+}
+
+void EntityStore::UpdateBounds(JobSystem& jobs) const
+{
+	const size_t count = GetCount();
+
+	jobs.ParallelFor(count, ENTITY_CHUNK_SIZE, [this](size_t begin, size_t end)
+	{
+		const ChunkState& chunk = m_chunks[begin / ENTITY_CHUNK_SIZE];
+		if (chunk.bounds_version == chunk.version)
+			return;
+
+		vec3_t box_min(m_pos_x[begin], m_pos_y[begin], m_pos_z[begin]);
+		vec3_t box_max = box_min;
+
+		for (size_t i = begin + 1; i < end; ++i)
+		{
+			box_min.x = std::min(box_min.x, m_pos_x[i]);
+			box_min.y = std::min(box_min.y, m_pos_y[i]);
+			box_min.z = std::min(box_min.z, m_pos_z[i]);
+			box_max.x = std::max(box_max.x, m_pos_x[i]);
+			box_max.y = std::max(box_max.y, m_pos_y[i]);
+			box_max.z = std::max(box_max.z, m_pos_z[i]);
+		}
+
+		chunk.bounds_min = box_min;
+		chunk.bounds_max = box_max;
+		chunk.bounds_version = chunk.version;
+	});
+}
+
+void EntityStore::ProjectViews(JobSystem& jobs, RenderView* views, size_t view_count, float margin) const
+{
+	PerfScope scope(PerfCounter::ProjectTime);
+
+	const size_t count = GetCount();
+	const size_t chunk_count = m_chunks.size();
+
+	// Shared by every view, only chunks that moved since last time are rescanned
+	UpdateBounds(jobs);
+
+	m_stale_view_chunks.clear();
+	for (size_t v = 0; v < view_count; ++v)
+	{
+		RenderView& view = views[v];
+		Projection& projection = view.projection;
+
+		projection.SetFOVFactors(view.camera.fov_factor);
+		projection.BeginCachedFrame(view.camera.position, count, chunk_count);
+
+		bool visibility_changed = view.visible_chunks.size() != chunk_count;
+		view.visible_chunks.resize(chunk_count, 0);
+
+		size_t culled = 0;
+		for (size_t chunk = 0; chunk < chunk_count; ++chunk)
+		{
+			const ChunkState& state = m_chunks[chunk];
+			uint8_t visible = IsBoxInView(state.bounds_min, state.bounds_max, view.camera, view.viewport, margin) ? 1 : 0;
+
+			visibility_changed |= visible != view.visible_chunks[chunk];
+			view.visible_chunks[chunk] = visible;
+			culled += visible ? 0 : 1;
+		}
+		PerfCounters::Add(PerfCounter::ChunksCulled, culled);
+
+		// Chunks entering or leaving the view change the image even when nothing needs reprojecting
+		if (visibility_changed)
+			projection.InvalidateCache();
+
+		for (size_t chunk = 0; chunk < chunk_count; ++chunk)
+		{
+			if (view.visible_chunks[chunk] && !projection.IsChunkCached(chunk, m_chunks[chunk].version))
+				m_stale_view_chunks.push_back({ static_cast<uint32_t>(v), static_cast<uint32_t>(chunk) });
+		}
+	}
+
+	if (FrameCapture* capture = FrameCapture::GetActive())
+	{
+		// Pairs are grouped by view in push order
+		size_t pair = 0;
+		for (size_t v = 0; v < view_count; ++v)
+		{
+			m_capture_chunks.clear();
+			for (; pair < m_stale_view_chunks.size() && m_stale_view_chunks[pair].view == v; ++pair)
+				m_capture_chunks.push_back(m_stale_view_chunks[pair].chunk);
+
+			CaptureProjection(*capture, static_cast<uint32_t>(v), views[v].camera, m_capture_chunks.data(), m_capture_chunks.size());
+		}
+	}
+
+	if (m_stale_view_chunks.empty())
+		return;
+
+	const ViewChunk* stale = m_stale_view_chunks.data();
+
+	jobs.ParallelFor(m_stale_view_chunks.size(), 1, [this, views, stale, count](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			RenderView& view = views[stale[i].view];
+			vec2_t* out = view.projection.GetProjectedPoints().data();
+
+			size_t first = static_cast<size_t>(stale[i].chunk) * ENTITY_CHUNK_SIZE;
+			size_t last = std::min(first + ENTITY_CHUNK_SIZE, count);
+
+			view.projection.ProjectRange(m_pos_x.data() + first, m_pos_y.data() + first, m_pos_z.data() + first,
+				last - first, view.camera.position, out + first);
+		}
+	});
+
+	for (const ViewChunk& pair : m_stale_view_chunks)
+	{
+		views[pair.view].projection.MarkChunkCached(pair.chunk, m_chunks[pair.chunk].version);
+	}
+}
+
+void EntityStore::CaptureProjection(FrameCapture& capture, uint32_t view, const Camera& camera, const uint32_t* chunks, size_t chunk_count) const
+{
+	const size_t count = GetCount();
+
+	for (size_t i = 0; i < chunk_count; ++i)
+	{
+		const size_t chunk = chunks[i];
+		if (!capture.NeedsPositions(chunk, m_chunks[chunk].version))
+			continue;
+
+		const size_t first = chunk * ENTITY_CHUNK_SIZE;
+		const size_t length = std::min(first + ENTITY_CHUNK_SIZE, count) - first;
+
+		capture.Record(CaptureRecord::Positions, static_cast<uint32_t>(first),
+			MakeCaptureSpan(m_pos_x.data() + first, length),
+			MakeCaptureSpan(m_pos_y.data() + first, length),
+			MakeCaptureSpan(m_pos_z.data() + first, length));
+	}
+
+	capture.Record(CaptureRecord::Project, view, camera.position, camera.fov_factor, static_cast<uint32_t>(count),
+		MakeCaptureSpan(chunks, chunk_count));
+}
@@ -0,0 +1,95 @@
+﻿#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+#include "vector.h"
+#include "job_system.hpp"
+#include "projection.hpp"
+#include "render_view.hpp"
+#include "frame_capture.hpp"
+#include "perf_counters.hpp"
+
+// Entities per chunk, the unit of parallel work and of change tracking
+#define ENTITY_CHUNK_SIZE 4096
+
+// Transforms stored as contiguous per-axis arrays (structure of arrays), indexed by entity id
+class EntityStore
+{
+public:
+	EntityStore() = default;
+
+public:
+	uint32_t Create(const vec3_t& position, const vec3_t& velocity = vec3_t());
+	void Reserve(size_t count);
+	void Clear();
+
+	size_t GetCount() const { return m_pos_x.size(); }
+	size_t GetChunkCount() const { return m_chunks.size(); }
+
+	vec3_t GetPosition(uint32_t id) const { return { m_pos_x[id], m_pos_y[id], m_pos_z[id] }; }
+	void SetPosition(uint32_t id, const vec3_t& position);
+	void SetVelocity(uint32_t id, const vec3_t& velocity);
+
+	const float* GetPositionsX() const { return m_pos_x.data(); }
+	const float* GetPositionsY() const { return m_pos_y.data(); }
+	const float* GetPositionsZ() const { return m_pos_z.data(); }
+
+	// Bumped whenever a chunk's positions change, never reused (across Clear and across stores)
+	uint64_t GetChunkVersion(size_t chunk) const { return m_chunks[chunk].version; }
+
+	// Next chunk version. Other point stores (PointCloud) take theirs from here too, so a view's projection cache never mixes them up
+	static uint64_t NextVersion() { return s_next_version.fetch_add(1); }
+
+public:
+	// Advances positions by velocity * dt, chunks without moving entities are skipped
+	void Integrate(JobSystem& jobs, float dt);
+
+	// Projects entities for several cameras at once, each view's projection is resized to GetCount().
+	// Only chunks whose version or view key changed since the last call are reprojected. Chunk bounds are refreshed
+	// once and shared by all views, chunks that cannot reach a viewport (within margin pixels) are culled per view and left unprojected.
+	// Every (view, stale chunk) pair is one job, so small scenes still spread across the workers
+	void ProjectViews(JobSystem& jobs, RenderView* views, size_t view_count, float margin) const;
+
+private:
+	struct ChunkState
+	{
+		uint32_t moving = 0;	// Entities with a non-zero velocity
+		uint64_t version = 0;
+
+		// Position bounds, valid while bounds_version == version
+		mutable vec3_t bounds_min;
+		mutable vec3_t bounds_max;
+		mutable uint64_t bounds_version = UINT64_MAX;
+	};
+
+	struct ViewChunk
+	{
+		uint32_t view;
+		uint32_t chunk;
+	};
+
+	void UpdateBounds(JobSystem& jobs) const;
+
+	// Records what one view projects this frame: positions of chunks the capture has not seen yet, then the camera
+	void CaptureProjection(FrameCapture& capture, uint32_t view, const Camera& camera, const uint32_t* chunks, size_t chunk_count) const;
+
+	void MarkDirty(uint32_t id) { m_chunks[id / ENTITY_CHUNK_SIZE].version = NextVersion(); }
+
+private:
+	std::vector<float> m_pos_x;
+	std::vector<float> m_pos_y;
+	std::vector<float> m_pos_z;
+
+	std::vector<float> m_vel_x;
+	std::vector<float> m_vel_y;
+	std::vector<float> m_vel_z;
+
+	std::vector<ChunkState> m_chunks;
+	static std::atomic<uint64_t> s_next_version;
+
+	// Chunk indices to reproject, reused across frames
+	mutable std::vector<ViewChunk> m_stale_view_chunks;
+	mutable std::vector<uint32_t> m_capture_chunks;
+};
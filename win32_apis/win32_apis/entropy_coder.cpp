@@ -0,0 +1,161 @@
+﻿#include <algorithm>
+#include <cstring>
+
+#include "entropy_coder.hpp"
+
+#define RANS_SCALE_BITS 12
+#define RANS_SCALE (1u << RANS_SCALE_BITS)
+#define RANS_LOW (1u << 23)		// State stays in [RANS_LOW, RANS_LOW << 8) between symbols
+
+namespace
+{
+	template<typename T>
+	void Append(std::vector<uint8_t>& out, const T& value)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	template<typename T>
+	bool Read(const uint8_t*& data, const uint8_t* end, T& value)
+	{
+		if (static_cast<size_t>(end - data) < sizeof(T))
+			return false;
+
+		std::memcpy(&value, data, sizeof(T));
+		data += sizeof(T);
+		return true;
+	}
+
+	// Byte histogram scaled to sum to RANS_SCALE, every byte that occurs keeps at least 1
+	void NormalizeFrequencies(const uint8_t* data, size_t size, uint16_t frequencies[256])
+	{
+		uint64_t counts[256] = {};
+		for (size_t i = 0; i < size; ++i)
+			counts[data[i]]++;
+
+		uint32_t sum = 0;
+		int largest = 0;
+		for (int s = 0; s < 256; ++s)
+		{
+			uint32_t frequency = 0;
+			if (counts[s] > 0)
+				frequency = std::max<uint32_t>(1, static_cast<uint32_t>(counts[s] * RANS_SCALE / size));
+
+			frequencies[s] = static_cast<uint16_t>(frequency);
+			sum += frequency;
+			if (counts[s] > counts[largest])
+				largest = s;
+		}
+
+		// Rounding down leaves a remainder, the max(1) above can overshoot
+		if (sum < RANS_SCALE)
+			frequencies[largest] = static_cast<uint16_t>(frequencies[largest] + (RANS_SCALE - sum));
+
+		while (sum > RANS_SCALE)
+		{
+			uint16_t* target = std::max_element(frequencies, frequencies + 256);
+			(*target)--;
+			sum--;
+		}
+	}
+}
+
+void RansEncode(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+	Append(out, static_cast<uint32_t>(size));
+	if (size == 0)
+		return;
+
+	uint16_t frequencies[256];
+	NormalizeFrequencies(data, size, frequencies);
+
+	uint32_t starts[256];
+	uint32_t start = 0;
+	for (int s = 0; s < 256; ++s)
+	{
+		starts[s] = start;
+		start += frequencies[s];
+	}
+
+	// rANS is last in, first out: encode backwards, then reverse the bytes so the decoder reads forwards
+	std::vector<uint8_t> reversed;
+	reversed.reserve(size / 2 + 16);
+
+	uint32_t state = RANS_LOW;
+	for (size_t i = size; i-- > 0;)
+	{
+		const uint32_t frequency = frequencies[data[i]];
+		const uint32_t state_max = ((RANS_LOW >> RANS_SCALE_BITS) << 8) * frequency;
+
+		while (state >= state_max)
+		{
+			reversed.push_back(static_cast<uint8_t>(state & 0xFF));
+			state >>= 8;
+		}
+
+		state = ((state / frequency) << RANS_SCALE_BITS) + (state % frequency) + starts[data[i]];
+	}
+
+	for (int s = 0; s < 256; ++s)
+		Append(out, frequencies[s]);
+	Append(out, state);
+	out.insert(out.end(), reversed.rbegin(), reversed.rend());
+}
+
+bool RansDecode(const uint8_t* data, size_t size, size_t max_size, std::vector<uint8_t>& out)
+{
+	const uint8_t* end = data + size;
+
+	uint32_t decoded_size;
+	if (!Read(data, end, decoded_size) || decoded_size > max_size)
+		return false;
+
+	out.resize(decoded_size);
+	if (decoded_size == 0)
+		return data == end;
+
+	uint16_t frequencies[256];
+	uint32_t starts[256];
+	uint32_t start = 0;
+	for (int s = 0; s < 256; ++s)
+	{
+		if (!Read(data, end, frequencies[s]))
+			return false;
+
+		starts[s] = start;
+		start += frequencies[s];
+	}
+
+	if (start != RANS_SCALE)
+		return false;
+
+	// Slot to byte lookup, one entry per probability unit
+	uint8_t symbols[RANS_SCALE];
+	for (int s = 0; s < 256; ++s)
+		std::memset(symbols + starts[s], s, frequencies[s]);
+
+	uint32_t state;
+	if (!Read(data, end, state) || state < RANS_LOW)
+		return false;
+
+	for (uint32_t i = 0; i < decoded_size; ++i)
+	{
+		const uint32_t slot = state & (RANS_SCALE - 1);
+		const uint8_t symbol = symbols[slot];
+
+		out[i] = symbol;
+		state = frequencies[symbol] * (state >> RANS_SCALE_BITS) + slot - starts[symbol];
+
+		while (state < RANS_LOW)
+		{
+			if (data == end)
+				return false;
+
+			state = (state << 8) | *data++;
+		}
+	}
+
+	// The encoder started from RANS_LOW, any other final state means the block was damaged
+	return state == RANS_LOW && data == end;
+}
@@ -0,0 +1,15 @@
+﻿#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Order-0 rANS byte coder (32-bit state, byte renormalization, 12-bit probabilities).
+// A block is uint32 size, uint16 frequencies[256] (sum 4096), uint32 state, then the renormalization bytes.
+// The 516 byte table is paid once per block, so it suits streams of several KB and up
+
+// Appends one encoded block of data to out
+void RansEncode(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+// Decodes one block from [data, data + size) into out (overwritten). False if the block is corrupt or truncated,
+// or if it claims more than max_size bytes (checked before anything is allocated)
+bool RansDecode(const uint8_t* data, size_t size, size_t max_size, std::vector<uint8_t>& out);
@@ -0,0 +1,113 @@
+﻿#include <iostream>
+#include <iterator>
+
+#include "frame_capture.hpp"
+
+FrameCapture* FrameCapture::s_active = nullptr;
+
+uint64_t HashFrame(const uint32_t* pixels, size_t count)
+{
+	// FNV-1a with one 32-bit pixel per step instead of one byte, a frame is hashed on every Present
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		hash ^= pixels[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+FrameCapture::~FrameCapture()
+{
+	Close();
+}
+
+bool FrameCapture::Open(const std::string& path, int width, int height, PixelFormat format, FramebufferLayout layout)
+{
+	Close();
+
+	m_stream.open(path, std::ios::binary | std::ios::trunc);
+	if (!m_stream)
+	{
+		std::cerr << "Frame capture: failed to open " << path << "\n";
+		return false;
+	}
+
+	FrameCaptureHeader header = {};
+	header.magic = FRAME_CAPTURE_MAGIC;
+	header.version = FRAME_CAPTURE_VERSION;
+	header.width = width;
+	header.height = height;
+	header.format = format;
+	header.layout = layout;
+
+	m_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	m_frame.clear();
+	m_position_versions.clear();
+
+	return true;
+}
+
+void FrameCapture::Close()
+{
+	if (!m_stream.is_open())
+		return;
+
+	// A frame that never presented is still worth keeping
+	if (!m_frame.empty())
+		m_stream.write(reinterpret_cast<const char*>(m_frame.data()), m_frame.size());
+
+	m_stream.close();
+	m_frame.clear();
+
+	if (s_active == this)
+		s_active = nullptr;
+}
+
+void FrameCapture::Present(bool presented, const uint32_t* front_buffer, size_t pixel_count)
+{
+	if (!m_stream.is_open())
+		return;
+
+	uint8_t flag = presented ? 1 : 0;
+	Record(CaptureRecord::Present, flag, HashFrame(front_buffer, pixel_count));
+
+	m_stream.write(reinterpret_cast<const char*>(m_frame.data()), m_frame.size());
+	m_frame.clear();
+}
+
+bool FrameCapture::NeedsPositions(size_t chunk, uint64_t version)
+{
+	if (chunk >= m_position_versions.size())
+		m_position_versions.resize(chunk + 1, UINT64_MAX);
+
+	if (m_position_versions[chunk] == version)
+		return false;
+
+	m_position_versions[chunk] = version;
+	return true;
+}
+
+bool FrameCaptureReader::Load(const std::string& path)
+{
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream)
+	{
+		std::cerr << "Frame capture: failed to open " << path << "\n";
+		return false;
+	}
+
+	if (!stream.read(reinterpret_cast<char*>(&m_header), sizeof(m_header)) ||
+		m_header.magic != FRAME_CAPTURE_MAGIC || m_header.version != FRAME_CAPTURE_VERSION)
+	{
+		std::cerr << "Frame capture: " << path << " is not a capture this build can read\n";
+		return false;
+	}
+
+	m_data.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	m_offset = 0;
+
+	return true;
+}
@@ -0,0 +1,188 @@
+﻿#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "pixel_format.hpp"
+#include "draw_kernels.hpp"
+
+#define FRAME_CAPTURE_MAGIC 0x50414344	// "DCAP"
+#define FRAME_CAPTURE_VERSION 4
+
+// Record tags, each followed by its payload in native (little endian) byte order.
+// Arrays are a uint32 count followed by the elements
+enum class CaptureRecord : uint8_t
+{
+	FrameBegin,		// uint32 frame, int32 dt_ms
+	KeyDown,		// int32 key
+
+	// Projection inputs
+	Positions,		// uint32 first, float xs[], float ys[], float zs[]
+	QuantizedPositions,	// uint32 first, vec3 origin, vec3 step, uint16 xs[], uint16 ys[], uint16 zs[] (one PointCloud chunk)
+	Project,		// uint32 view, vec3 camera, float fov, uint32 point_count, uint32 stale_chunks[]
+
+	// Renderer, immediate
+	Clear,			// uint32 color
+	Pixel,			// int32 x, y, uint32 color
+	Grid,			// uint32 color, int32 spacing
+	Polygon,		// uint32 color, vec2 points[]
+	LineAA,			// vec2 a, b, uint32 color
+	Polyline,		// uint32 color, uint8 closed, vec2 points[]
+	Wireframe,		// uint32 color, vec2 origin, vec2 points[], MeshEdge edges[]
+	TypedPixel,		// uint8 mode, uint8 clip, int32 x, y, uint32 color
+	TypedSpan,		// uint8 mode, uint8 clip, int32 x, y, length, uint32 color
+	TypedRect,		// uint8 mode, uint8 clip, int32 x, y, width, height, uint32 color
+	AlphaMasks,		// int32 x, y, uint32 color, int32 stride, AlphaMaskRect rects[], uint8 mask[] (rects repacked into mask)
+
+	// BinRasterizer
+	BinBegin,
+	BinViewport,	// int32 x, y, width, height
+	BinClear,		// uint32 color
+	BinGrid,		// uint32 color, int32 spacing
+	BinRect,		// int32 x, y, width, height, uint32 color
+	BinTriangle,	// vec2 a, b, c, uint32 color
+	BinFlush,
+
+	Skip,
+	Present			// uint8 presented, uint64 front buffer hash
+};
+
+struct FrameCaptureHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	int32_t width;
+	int32_t height;
+	PixelFormat format;
+	FramebufferLayout layout;
+	uint8_t reserved[2];
+};
+
+// Array payload, written as uint32 count + elements
+template<typename T>
+struct CaptureSpan
+{
+	const T* data;
+	uint32_t count;
+};
+
+template<typename T>
+inline CaptureSpan<T> MakeCaptureSpan(const T* data, size_t count)
+{
+	return CaptureSpan<T>{ data, static_cast<uint32_t>(count) };
+}
+
+// FNV-1a over the pixels (a word at a time), the image hash stored with every Present
+uint64_t HashFrame(const uint32_t* pixels, size_t count);
+
+// Serializes what an app submits per frame: draw calls (Renderer and BinRasterizer), projection inputs
+// (changed positions, cameras, reprojected chunks) and input events. Records are buffered per frame and
+// written on Present. Only the rendering thread records, workers never see the capture
+class FrameCapture
+{
+public:
+	FrameCapture() = default;
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+public:
+	bool Open(const std::string& path, int width, int height, PixelFormat format, FramebufferLayout layout);
+	void Close();
+	bool IsOpen() const { return m_stream.is_open(); }
+
+	// The capture the Renderer, BinRasterizer and EntityStore report to, null when not capturing
+	static FrameCapture* GetActive() { return s_active; }
+	static void SetActive(FrameCapture* capture) { s_active = capture; }
+
+	template<typename... Args>
+	void Record(CaptureRecord type, const Args&... args)
+	{
+		Append(&type, sizeof(type));
+		(Write(args), ...);
+	}
+
+	// Writes the buffered frame after recording the Present
+	void Present(bool presented, const uint32_t* front_buffer, size_t pixel_count);
+
+	// Positions are only recorded when a chunk's version moved since they were last written
+	bool NeedsPositions(size_t chunk, uint64_t version);
+
+private:
+	template<typename T>
+	void Write(const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "capture payloads are raw bytes");
+		Append(&value, sizeof(T));
+	}
+
+	template<typename T>
+	void Write(const CaptureSpan<T>& span)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "capture payloads are raw bytes");
+		Append(&span.count, sizeof(span.count));
+		Append(span.data, sizeof(T) * span.count);
+	}
+
+	void Append(const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		m_frame.insert(m_frame.end(), bytes, bytes + size);
+	}
+
+private:
+	std::ofstream m_stream;
+	std::vector<uint8_t> m_frame;
+	std::vector<uint64_t> m_position_versions;
+
+	static FrameCapture* s_active;
+};
+
+// Sequential reader over a loaded capture
+class FrameCaptureReader
+{
+public:
+	bool Load(const std::string& path);
+
+	const FrameCaptureHeader& GetHeader() const { return m_header; }
+	bool AtEnd() const { return m_offset >= m_data.size(); }
+
+	// False once the data runs out, a truncated capture is not an error until a record is cut
+	bool ReadRecord(CaptureRecord& type) { return Read(type); }
+
+	template<typename T>
+	bool Read(T& value)
+	{
+		if (m_offset + sizeof(T) > m_data.size())
+			return false;
+
+		std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+		m_offset += sizeof(T);
+		return true;
+	}
+
+	template<typename T>
+	bool ReadArray(std::vector<T>& values)
+	{
+		uint32_t count;
+		if (!Read(count) || m_offset + sizeof(T) * static_cast<size_t>(count) > m_data.size())
+			return false;
+
+		values.resize(count);
+		if (count > 0)
+			std::memcpy(values.data(), m_data.data() + m_offset, sizeof(T) * count);
+
+		m_offset += sizeof(T) * count;
+		return true;
+	}
+
+private:
+	FrameCaptureHeader m_header = {};
+	std::vector<uint8_t> m_data;
+	size_t m_offset = 0;
+};
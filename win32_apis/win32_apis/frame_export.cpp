@@ -0,0 +1,307 @@
+﻿#include "frame_export.hpp"
+
+#ifdef __linux__
+#include <iostream>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <cerrno>
+#include <new>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+namespace
+{
+	static_assert(sizeof(SharedFrameSlot) <= SHARED_FRAME_PIXEL_OFFSET, "slot header overlaps the pixels");
+	static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+		"shared atomics must be lock free");
+
+	// Not FUTEX_PRIVATE_FLAG, waiters live in other processes
+	inline void FutexWake(std::atomic<uint32_t>* word)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	inline void FutexWait(std::atomic<uint32_t>* word, uint32_t expected, int timeout_ms)
+	{
+		timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+	}
+
+	inline uint64_t GetMonotonicNs()
+	{
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+	}
+
+	inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+SharedFrameExporter::SharedFrameExporter()
+	: m_memory(nullptr), m_size(0), m_header(nullptr), m_sequence(1), m_in_frame(false)
+{
+}
+
+SharedFrameExporter::~SharedFrameExporter()
+{
+	Destroy();
+}
+
+bool SharedFrameExporter::Create(const std::string& name, int width, int height, int slot_count)
+{
+	Destroy();
+
+	if (width <= 0 || height <= 0 || slot_count < 2)
+	{
+		std::cerr << "Invalid shared frame size " << width << "x" << height << " with " << slot_count << " slots" << std::endl;
+		return false;
+	}
+
+	const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+	const uint64_t stride = static_cast<uint64_t>(width) * sizeof(uint32_t);
+
+	// Page aligned slots so a consumer can map or upload a single slot
+	const uint64_t slot_offset = AlignUp(sizeof(SharedFrameHeader), page_size);
+	const uint64_t slot_size = AlignUp(SHARED_FRAME_PIXEL_OFFSET + stride * height, page_size);
+	const size_t size = static_cast<size_t>(slot_offset + slot_size * slot_count);
+
+	int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+	if (fd < 0)
+	{
+		std::cerr << "shm_open(" << name << ") failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+	{
+		std::cerr << "ftruncate(" << name << ") failed: " << std::strerror(errno) << std::endl;
+		close(fd);
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (memory == MAP_FAILED)
+	{
+		std::cerr << "mmap(" << name << ") failed: " << std::strerror(errno) << std::endl;
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	m_name = name;
+	m_memory = memory;
+	m_size = size;
+	m_sequence = 1;
+	m_in_frame = false;
+
+	// ftruncate zero fills, so every slot stamp starts out as "no frame"
+	m_header = new (memory) SharedFrameHeader();
+	m_header->width = static_cast<uint32_t>(width);
+	m_header->height = static_cast<uint32_t>(height);
+	m_header->stride = static_cast<uint32_t>(stride);
+	m_header->slot_count = static_cast<uint32_t>(slot_count);
+	m_header->slot_size = slot_size;
+	m_header->slot_offset = slot_offset;
+	m_header->latest_sequence.store(0, std::memory_order_relaxed);
+	m_header->futex_word.store(0, std::memory_order_relaxed);
+	m_header->version = SHARED_FRAME_VERSION;
+
+	// Readers check the magic last
+	std::atomic_thread_fence(std::memory_order_release);
+	m_header->magic = SHARED_FRAME_MAGIC;
+
+	return true;
+}
+
+void SharedFrameExporter::Destroy()
+{
+	if (!m_memory)
+		return;
+
+	munmap(m_memory, m_size);
+	shm_unlink(m_name.c_str());
+
+	m_memory = nullptr;
+	m_header = nullptr;
+	m_size = 0;
+	m_name.clear();
+}
+
+SharedFrameSlot* SharedFrameExporter::GetSlot(uint64_t sequence) const
+{
+	uint8_t* base = static_cast<uint8_t*>(m_memory) + m_header->slot_offset;
+	return reinterpret_cast<SharedFrameSlot*>(base + (sequence % m_header->slot_count) * m_header->slot_size);
+}
+
+uint32_t* SharedFrameExporter::BeginFrame()
+{
+	if (!m_header)
+		return nullptr;
+
+	SharedFrameSlot* slot = GetSlot(m_sequence);
+
+	// Odd stamp: readers still holding an older frame in this slot see it torn
+	slot->stamp.store(m_sequence * 2 + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	m_in_frame = true;
+	return reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(slot) + SHARED_FRAME_PIXEL_OFFSET);
+}
+
+void SharedFrameExporter::EndFrame()
+{
+	if (!m_header || !m_in_frame)
+		return;
+
+	SharedFrameSlot* slot = GetSlot(m_sequence);
+	slot->timestamp_ns = GetMonotonicNs();
+	slot->stamp.store(m_sequence * 2, std::memory_order_release);
+
+	m_header->latest_sequence.store(m_sequence, std::memory_order_release);
+	m_header->futex_word.fetch_add(1, std::memory_order_release);
+	FutexWake(&m_header->futex_word);
+
+	m_sequence++;
+	m_in_frame = false;
+}
+
+bool SharedFrameExporter::PublishFrame(const uint32_t* pixels, int width, int height)
+{
+	if (!m_header || width != static_cast<int>(m_header->width) || height != static_cast<int>(m_header->height))
+		return false;
+
+	uint32_t* target = BeginFrame();
+	std::memcpy(target, pixels, static_cast<size_t>(m_header->stride) * m_header->height);
+	EndFrame();
+
+	return true;
+}
+
+SharedFrameReader::SharedFrameReader()
+	: m_memory(nullptr), m_size(0), m_header(nullptr)
+{
+}
+
+SharedFrameReader::~SharedFrameReader()
+{
+	Close();
+}
+
+bool SharedFrameReader::Open(const std::string& name)
+{
+	Close();
+
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+	{
+		std::cerr << "shm_open(" << name << ") failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SharedFrameHeader))
+	{
+		std::cerr << "Shared frame object " << name << " is too small" << std::endl;
+		close(fd);
+		return false;
+	}
+
+	// Read only mapping, FUTEX_WAIT only needs to read the word
+	const size_t size = static_cast<size_t>(info.st_size);
+	void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (memory == MAP_FAILED)
+	{
+		std::cerr << "mmap(" << name << ") failed: " << std::strerror(errno) << std::endl;
+		return false;
+	}
+
+	SharedFrameHeader* header = static_cast<SharedFrameHeader*>(memory);
+	const bool valid = header->magic == SHARED_FRAME_MAGIC && header->version == SHARED_FRAME_VERSION;
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	if (!valid || header->slot_offset + header->slot_size * header->slot_count > size)
+	{
+		std::cerr << "Shared frame object " << name << " has an unknown layout" << std::endl;
+		munmap(memory, size);
+		return false;
+	}
+
+	m_memory = memory;
+	m_size = size;
+	m_header = header;
+	return true;
+}
+
+void SharedFrameReader::Close()
+{
+	if (!m_memory)
+		return;
+
+	munmap(m_memory, m_size);
+	m_memory = nullptr;
+	m_header = nullptr;
+	m_size = 0;
+}
+
+const SharedFrameSlot* SharedFrameReader::GetSlot(uint64_t sequence) const
+{
+	const uint8_t* base = static_cast<const uint8_t*>(m_memory) + m_header->slot_offset;
+	return reinterpret_cast<const SharedFrameSlot*>(base + (sequence % m_header->slot_count) * m_header->slot_size);
+}
+
+uint64_t SharedFrameReader::WaitForFrame(uint64_t last_sequence, int timeout_ms)
+{
+	if (!m_header)
+		return 0;
+
+	const uint64_t deadline = GetMonotonicNs() + static_cast<uint64_t>(timeout_ms) * 1000000ull;
+
+	for (;;)
+	{
+		// Load the futex word first so a publish between the check and the wait still wakes us
+		uint32_t word = m_header->futex_word.load(std::memory_order_acquire);
+
+		uint64_t latest = m_header->latest_sequence.load(std::memory_order_acquire);
+		if (latest > last_sequence)
+			return latest;
+
+		uint64_t now = GetMonotonicNs();
+		if (now >= deadline)
+			return 0;
+
+		FutexWait(&m_header->futex_word, word, static_cast<int>((deadline - now + 999999) / 1000000));
+	}
+}
+
+const uint32_t* SharedFrameReader::GetFramePixels(uint64_t sequence) const
+{
+	if (!m_header || sequence == 0 || !IsFrameIntact(sequence))
+		return nullptr;
+
+	return reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(GetSlot(sequence)) + SHARED_FRAME_PIXEL_OFFSET);
+}
+
+bool SharedFrameReader::IsFrameIntact(uint64_t sequence) const
+{
+	if (!m_header || sequence == 0)
+		return false;
+
+	// Orders the caller's pixel reads before the stamp re-check
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return GetSlot(sequence)->stamp.load(std::memory_order_relaxed) == sequence * 2;
+}
+
+#endif
@@ -0,0 +1,106 @@
+﻿#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+
+#include "iframe_sink.hpp"
+
+#ifdef __linux__
+
+#define SHARED_FRAME_MAGIC 0x41564F44	// "DOVA"
+#define SHARED_FRAME_VERSION 1
+#define SHARED_FRAME_PIXEL_OFFSET 64	// Pixels start this far into a slot
+
+// Lives at offset 0 of the shared memory object, slot i starts at slot_offset + i * slot_size
+struct SharedFrameHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;						// Bytes per row, pixels are 0xAARRGGBB
+	uint32_t slot_count;
+	uint64_t slot_size;
+	uint64_t slot_offset;
+	std::atomic<uint64_t> latest_sequence;	// Last complete frame, 0 = none yet
+	std::atomic<uint32_t> futex_word;		// Bumped on every publish, consumers FUTEX_WAIT on it
+};
+
+struct SharedFrameSlot
+{
+	// Seqlock stamp: 2 * sequence + 1 while frame `sequence` is written, 2 * sequence once complete
+	std::atomic<uint64_t> stamp;
+	uint64_t timestamp_ns;					// CLOCK_MONOTONIC at publish
+};
+
+// Publishes frames into a POSIX shared memory ring (shm_open) that local processes map read-only.
+// Sequence numbers start at 1, slot = sequence % slot_count
+class SharedFrameExporter : public IFrameSink
+{
+public:
+	SharedFrameExporter();
+	~SharedFrameExporter();
+
+	SharedFrameExporter(const SharedFrameExporter&) = delete;
+	SharedFrameExporter& operator=(const SharedFrameExporter&) = delete;
+
+public:
+	// name is a shm_open name such as "/dova_frames", the object is unlinked again in Destroy
+	bool Create(const std::string& name, int width, int height, int slot_count = 3);
+	void Destroy();
+
+	// Zero copy path: present straight into the returned slot (e.g. Renderer::SetFrontBuffer), then EndFrame
+	uint32_t* BeginFrame();
+	void EndFrame();
+
+	// Copying path
+	bool PublishFrame(const uint32_t* pixels, int width, int height) override;
+
+private:
+	SharedFrameSlot* GetSlot(uint64_t sequence) const;
+
+private:
+	std::string m_name;
+	void* m_memory;
+	size_t m_size;
+	SharedFrameHeader* m_header;
+	uint64_t m_sequence;		// Next frame to publish
+	bool m_in_frame;
+};
+
+// Consumer side of SharedFrameExporter
+class SharedFrameReader
+{
+public:
+	SharedFrameReader();
+	~SharedFrameReader();
+
+	SharedFrameReader(const SharedFrameReader&) = delete;
+	SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+
+public:
+	bool Open(const std::string& name);
+	void Close();
+
+	int GetWidth() const { return m_header ? static_cast<int>(m_header->width) : 0; }
+	int GetHeight() const { return m_header ? static_cast<int>(m_header->height) : 0; }
+
+	// Blocks up to timeout_ms for a frame newer than last_sequence. Returns its sequence, 0 on timeout
+	uint64_t WaitForFrame(uint64_t last_sequence, int timeout_ms);
+
+	// Zero copy view of a frame, null if the writer already reused its slot.
+	// Check IsFrameIntact after reading, the writer never waits for readers
+	const uint32_t* GetFramePixels(uint64_t sequence) const;
+	bool IsFrameIntact(uint64_t sequence) const;
+
+private:
+	const SharedFrameSlot* GetSlot(uint64_t sequence) const;
+
+private:
+	void* m_memory;
+	size_t m_size;
+	SharedFrameHeader* m_header;
+};
+
+#endif
@@ -0,0 +1,571 @@
+﻿#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <type_traits>
+
+#include "frame_replay.hpp"
+#include "entity_store.hpp"
+#include "job_system.hpp"
+
+// Bounds for counts read from a capture, a damaged value must fail the record instead of
+// allocating gigabytes
+#define REPLAY_MAX_POINTS (1u << 26)	// 768 MB of positions
+#define REPLAY_MAX_VIEWS 256
+
+namespace
+{
+	const char* const STAGE_NAMES[FrameReplayer::StageCount] = { "project", "bin", "raster", "present" };
+
+	// Typed records carry their blend mode as a byte, turn it back into a type. The recorded clip
+	// mode is not trusted: an unclipped record from a damaged file would write outside the back
+	// buffer, and in-bounds records draw the same pixels clipped, so replay always clips
+	template<typename Fn>
+	void DispatchTyped(uint8_t mode, Fn&& fn)
+	{
+		using Opaque = std::integral_constant<BlendMode, BlendMode::Opaque>;
+		using Alpha = std::integral_constant<BlendMode, BlendMode::Alpha>;
+
+		if (mode == static_cast<uint8_t>(BlendMode::Alpha))
+			fn(Alpha());
+		else
+			fn(Opaque());
+	}
+
+	// Every rect of an AlphaMasks record must read inside the recorded mask
+	bool MaskRectsInBounds(const std::vector<AlphaMaskRect>& rects, int32_t stride, size_t mask_size)
+	{
+		if (stride <= 0)
+			return false;
+
+		for (const AlphaMaskRect& rect : rects)
+		{
+			if (static_cast<size_t>(rect.src_x) + rect.width > static_cast<size_t>(stride) ||
+				(static_cast<size_t>(rect.src_y) + rect.height) * static_cast<size_t>(stride) > mask_size)
+				return false;
+		}
+		return true;
+	}
+
+	// The three axis arrays of a positions record, stored from index first on
+	template<typename T>
+	bool ReadPositionAxes(FrameCaptureReader& reader, uint32_t first, std::vector<T>* const (&axes)[3], std::vector<T>& values)
+	{
+		for (std::vector<T>* axis : axes)
+		{
+			if (!reader.ReadArray(values))
+				return false;
+
+			const size_t end = static_cast<size_t>(first) + values.size();
+			if (end > REPLAY_MAX_POINTS)
+				return false;
+
+			if (axis->size() < end)
+				axis->resize(end);
+
+			std::copy(values.begin(), values.end(), axis->begin() + first);
+		}
+		return true;
+	}
+}
+
+bool FrameReplayer::Run(const std::string& capture_path, const std::string& csv_path)
+{
+	FrameCaptureReader reader;
+	if (!reader.Load(capture_path))
+		return false;
+
+	const FrameCaptureHeader& header = reader.GetHeader();
+	if (header.width <= 0 || header.height <= 0)
+	{
+		std::cerr << "Replay: invalid frame size " << header.width << "x" << header.height << "\n";
+		return false;
+	}
+
+	m_front_buffer.assign(static_cast<size_t>(header.width) * header.height, 0);
+	m_renderer.Initialize(m_front_buffer.data(), header.width, header.height, header.format, header.layout);
+
+	m_frames.clear();
+	m_skipped = 0;
+	m_current = FrameStats();
+	m_stage = StageCount;
+
+	CaptureRecord type;
+	while (reader.ReadRecord(type))
+	{
+		if (!Replay(reader, type))
+		{
+			std::cerr << "Replay: " << capture_path << " is truncated or corrupt after frame " << m_frames.size() << "\n";
+			m_renderer.Shutdown();
+			return false;
+		}
+	}
+
+	m_renderer.Shutdown();
+	Report(csv_path);
+
+	return std::all_of(m_frames.begin(), m_frames.end(), [](const FrameStats& frame) { return frame.match; });
+}
+
+bool FrameReplayer::Replay(FrameCaptureReader& reader, CaptureRecord type)
+{
+	switch (type)
+	{
+	case CaptureRecord::FrameBegin:
+	{
+		uint32_t frame;
+		int32_t dt;
+		if (!reader.Read(frame) || !reader.Read(dt))
+			return false;
+
+		EnterStage(StageCount);
+		m_current = FrameStats();
+		m_current.frame = frame;
+		return true;
+	}
+
+	case CaptureRecord::KeyDown:
+	{
+		// Input is already baked into the draw calls that follow it
+		int32_t key;
+		return reader.Read(key);
+	}
+
+	case CaptureRecord::Positions:
+		EnterStage(StageProject);
+		return ReplayPositions(reader);
+
+	case CaptureRecord::QuantizedPositions:
+		EnterStage(StageProject);
+		return ReplayQuantizedPositions(reader);
+
+	case CaptureRecord::Project:
+		EnterStage(StageProject);
+		return ReplayProject(reader);
+
+	case CaptureRecord::Clear:
+	{
+		uint32_t color;
+		if (!reader.Read(color))
+			return false;
+
+		EnterStage(StageRaster);
+		m_renderer.ClearColorBuffer(color);
+		return true;
+	}
+
+	case CaptureRecord::Pixel:
+	{
+		int32_t x, y;
+		uint32_t color;
+		if (!reader.Read(x) || !reader.Read(y) || !reader.Read(color))
+			return false;
+
+		EnterStage(StageRaster);
+		m_renderer.DrawPixel(x, y, color);
+		return true;
+	}
+
+	case CaptureRecord::Grid:
+	{
+		uint32_t color;
+		int32_t spacing;
+		if (!reader.Read(color) || !reader.Read(spacing))
+			return false;
+
+		EnterStage(StageRaster);
+		m_renderer.DrawGrid(color, spacing);
+		return true;
+	}
+
+	case CaptureRecord::Polygon:
+	{
+		uint32_t color;
+		if (!reader.Read(color) || !reader.ReadArray(m_points))
+			return false;
+
+		EnterStage(StageRaster);
+		m_renderer.DrawConvexPolygon(m_points.data(), static_cast<int>(m_points.size()), color);
+		return true;
+	}
+
+	case CaptureRecord::LineAA:
+	{
+		vec2_t a, b;
+		uint32_t color;
+		if (!reader.Read(a) || !reader.Read(b) || !reader.Read(color))
+			return false;
+
+		EnterStage(StageRaster);
+		m_renderer.DrawLineAA(a, b, color);
+		return true;
+	}
+
+	case CaptureRecord::Polyline:
+	{
+		uint32_t color;
+		uint8_t closed;
+		if (!reader.Read(color) || !reader.Read(closed) || !reader.ReadArray(m_points))
+			return false;
+
+		EnterStage(StageRaster);
+		m_renderer.DrawPolyline(m_points.data(), static_cast<int>(m_points.size()), color, closed != 0);
+		return true;
+	}
+
+	case CaptureRecord::Wireframe:
+	{
+		uint32_t color;
+		vec2_t origin;
+		if (!reader.Read(color) || !reader.Read(origin) || !reader.ReadArray(m_points) || !reader.ReadArray(m_edges))
+			return false;
+
+		EnterStage(StageRaster);
+		m_renderer.DrawWireframe(m_points.data(), m_points.size(), m_edges.data(), m_edges.size(), color, origin);
+		return true;
+	}
+
+	case CaptureRecord::TypedPixel:
+	{
+		uint8_t mode, clip;
+		int32_t x, y;
+		uint32_t color;
+		if (!reader.Read(mode) || !reader.Read(clip) || !reader.Read(x) || !reader.Read(y) || !reader.Read(color))
+			return false;
+
+		EnterStage(StageRaster);
+		DispatchTyped(mode, [&](auto blend)
+		{
+			m_renderer.DrawPixel<decltype(blend)::value, ClipMode::Clip>(x, y, color);
+		});
+		return true;
+	}
+
+	case CaptureRecord::TypedSpan:
+	{
+		uint8_t mode, clip;
+		int32_t x, y, length;
+		uint32_t color;
+		if (!reader.Read(mode) || !reader.Read(clip) || !reader.Read(x) || !reader.Read(y) ||
+			!reader.Read(length) || !reader.Read(color))
+			return false;
+
+		EnterStage(StageRaster);
+		DispatchTyped(mode, [&](auto blend)
+		{
+			m_renderer.FillSpan<decltype(blend)::value, ClipMode::Clip>(x, y, length, color);
+		});
+		return true;
+	}
+
+	case CaptureRecord::TypedRect:
+	{
+		uint8_t mode, clip;
+		int32_t x, y, width, height;
+		uint32_t color;
+		if (!reader.Read(mode) || !reader.Read(clip) || !reader.Read(x) || !reader.Read(y) ||
+			!reader.Read(width) || !reader.Read(height) || !reader.Read(color))
+			return false;
+
+		EnterStage(StageRaster);
+		DispatchTyped(mode, [&](auto blend)
+		{
+			m_renderer.FillRect<decltype(blend)::value, ClipMode::Clip>(x, y, width, height, color);
+		});
+		return true;
+	}
+
+	case CaptureRecord::AlphaMasks:
+	{
+		int32_t x, y, stride;
+		uint32_t color;
+		if (!reader.Read(x) || !reader.Read(y) || !reader.Read(color) || !reader.Read(stride) ||
+			!reader.ReadArray(m_mask_rects) || !reader.ReadArray(m_mask) || !MaskRectsInBounds(m_mask_rects, stride, m_mask.size()))
+			return false;
+
+		EnterStage(StageRaster);
+		m_renderer.DrawAlphaMasks(x, y, m_mask.data(), stride, m_mask_rects.data(), m_mask_rects.size(), color);
+		return true;
+	}
+
+	case CaptureRecord::BinBegin:
+		EnterStage(StageBin);
+		m_binner.Begin(m_renderer);
+		return true;
+
+	case CaptureRecord::BinViewport:
+	{
+		Viewport viewport;
+		if (!reader.Read(viewport.x) || !reader.Read(viewport.y) || !reader.Read(viewport.width) || !reader.Read(viewport.height))
+			return false;
+
+		EnterStage(StageBin);
+		m_binner.SetViewport(viewport);
+		return true;
+	}
+
+	case CaptureRecord::BinClear:
+	{
+		uint32_t color;
+		if (!reader.Read(color))
+			return false;
+
+		EnterStage(StageBin);
+		m_binner.ClearColorBuffer(color);
+		return true;
+	}
+
+	case CaptureRecord::BinGrid:
+	{
+		uint32_t color;
+		int32_t spacing;
+		if (!reader.Read(color) || !reader.Read(spacing))
+			return false;
+
+		EnterStage(StageBin);
+		m_binner.DrawGrid(color, spacing);
+		return true;
+	}
+
+	case CaptureRecord::BinRect:
+	{
+		int32_t x, y, width, height;
+		uint32_t color;
+		if (!reader.Read(x) || !reader.Read(y) || !reader.Read(width) || !reader.Read(height) || !reader.Read(color))
+			return false;
+
+		EnterStage(StageBin);
+		m_binner.DrawRectangle(x, y, width, height, color);
+		return true;
+	}
+
+	case CaptureRecord::BinTriangle:
+	{
+		vec2_t a, b, c;
+		uint32_t color;
+		if (!reader.Read(a) || !reader.Read(b) || !reader.Read(c) || !reader.Read(color))
+			return false;
+
+		EnterStage(StageBin);
+		m_binner.DrawTriangle(a, b, c, color);
+		return true;
+	}
+
+	case CaptureRecord::BinFlush:
+		EnterStage(StageRaster);
+		m_binner.Flush(JobSystem::GetInstance());
+		return true;
+
+	case CaptureRecord::Skip:
+		m_renderer.SkipFrame();
+		return true;
+
+	case CaptureRecord::Present:
+		return ReplayPresent(reader);
+	}
+
+	// Unknown tag, nothing after it can be trusted
+	return false;
+}
+
+bool FrameReplayer::ReplayPositions(FrameCaptureReader& reader)
+{
+	uint32_t first;
+	if (!reader.Read(first))
+		return false;
+
+	std::vector<float>* const axes[3] = { &m_xs, &m_ys, &m_zs };
+	if (!ReadPositionAxes(reader, first, axes, m_values))
+		return false;
+
+	// Chunks are projected from the floats until a quantized record replaces them
+	const size_t end = static_cast<size_t>(first) + m_values.size();
+	for (size_t chunk = first / ENTITY_CHUNK_SIZE; chunk * ENTITY_CHUNK_SIZE < end; ++chunk)
+	{
+		if (chunk >= m_chunk_sources.size())
+			m_chunk_sources.resize(chunk + 1);
+		m_chunk_sources[chunk].quantized = false;
+	}
+
+	return true;
+}
+
+bool FrameReplayer::ReplayQuantizedPositions(FrameCaptureReader& reader)
+{
+	uint32_t first;
+	ChunkSource source;
+	if (!reader.Read(first) || !reader.Read(source.origin) || !reader.Read(source.step))
+		return false;
+
+	// One chunk per record, origin and step are that chunk's
+	if (first % ENTITY_CHUNK_SIZE != 0)
+		return false;
+
+	std::vector<uint16_t>* const axes[3] = { &m_qx, &m_qy, &m_qz };
+	if (!ReadPositionAxes(reader, first, axes, m_quantized_values) || m_quantized_values.size() > ENTITY_CHUNK_SIZE)
+		return false;
+
+	const size_t chunk = first / ENTITY_CHUNK_SIZE;
+	if (chunk >= m_chunk_sources.size())
+		m_chunk_sources.resize(chunk + 1);
+
+	source.quantized = true;
+	m_chunk_sources[chunk] = source;
+	return true;
+}
+
+bool FrameReplayer::ReplayProject(FrameCaptureReader& reader)
+{
+	uint32_t view, point_count;
+	vec3_t camera;
+	float fov;
+	if (!reader.Read(view) || !reader.Read(camera) || !reader.Read(fov) || !reader.Read(point_count) || !reader.ReadArray(m_chunks))
+		return false;
+
+	if (view >= REPLAY_MAX_VIEWS || point_count > REPLAY_MAX_POINTS)
+		return false;
+
+	// Positions of every reprojected chunk are recorded before the Project that reads them
+	const size_t recorded_floats = std::min({ m_xs.size(), m_ys.size(), m_zs.size() });
+	const size_t recorded_quantized = std::min({ m_qx.size(), m_qy.size(), m_qz.size() });
+	for (uint32_t chunk : m_chunks)
+	{
+		const size_t first = static_cast<size_t>(chunk) * ENTITY_CHUNK_SIZE;
+		if (first >= point_count)
+			continue;
+
+		const size_t last = std::min<size_t>(first + ENTITY_CHUNK_SIZE, point_count);
+		if (chunk >= m_chunk_sources.size() || last > (m_chunk_sources[chunk].quantized ? recorded_quantized : recorded_floats))
+			return false;
+	}
+
+	if (view >= m_projections.size())
+		m_projections.resize(view + 1);
+
+	Projection& projection = m_projections[view];
+	projection.SetFOVFactors(fov);
+	if (projection.GetPointCount() != point_count)
+		projection.ResizeProjectedPoints(point_count);
+
+	if (m_chunks.empty())
+		return true;
+
+	// Same split as EntityStore::ProjectViews, one job per stale chunk
+	vec2_t* out = projection.GetProjectedPoints().data();
+	const uint32_t* chunks = m_chunks.data();
+	const Projection& source = projection;
+
+	JobSystem::GetInstance().ParallelFor(m_chunks.size(), 1, [this, out, chunks, point_count, camera, &source](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			size_t first = static_cast<size_t>(chunks[i]) * ENTITY_CHUNK_SIZE;
+			size_t last = std::min<size_t>(first + ENTITY_CHUNK_SIZE, point_count);
+			if (first >= last)
+				continue;
+
+			const ChunkSource& chunk = m_chunk_sources[chunks[i]];
+			if (chunk.quantized)
+				source.ProjectQuantizedRange(m_qx.data() + first, m_qy.data() + first, m_qz.data() + first, last - first,
+					chunk.origin, chunk.step, camera, out + first);
+			else
+				source.ProjectRange(m_xs.data() + first, m_ys.data() + first, m_zs.data() + first, last - first, camera, out + first);
+		}
+	});
+
+	return true;
+}
+
+bool FrameReplayer::ReplayPresent(FrameCaptureReader& reader)
+{
+	uint8_t presented;
+	uint64_t hash;
+	if (!reader.Read(presented) || !reader.Read(hash))
+		return false;
+
+	EnterStage(StagePresent);
+	m_renderer.SwapBuffers();
+	EnterStage(StageCount);
+
+	m_current.hash = HashFrame(m_front_buffer.data(), m_front_buffer.size());
+
+	// A skipped frame keeps the previous image, which is what the capture hashed too
+	m_current.match = m_current.hash == hash;
+	if (!presented)
+		++m_skipped;
+
+	m_frames.push_back(m_current);
+	m_current = FrameStats();
+	m_current.frame = m_frames.back().frame + 1;
+
+	return true;
+}
+
+void FrameReplayer::EnterStage(int stage)
+{
+	// Contiguous records of one stage are timed as a single run
+	if (stage == m_stage)
+		return;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (m_stage != StageCount)
+		m_current.stage_ms[m_stage] += std::chrono::duration<double, std::milli>(now - m_stage_start).count();
+
+	m_stage = stage;
+	m_stage_start = now;
+}
+
+void FrameReplayer::Report(const std::string& csv_path) const
+{
+	size_t mismatches = 0;
+	double total[StageCount] = {};
+	double peak[StageCount] = {};
+
+	for (const FrameStats& frame : m_frames)
+	{
+		mismatches += frame.match ? 0 : 1;
+		for (int stage = 0; stage < StageCount; ++stage)
+		{
+			total[stage] += frame.stage_ms[stage];
+			peak[stage] = std::max(peak[stage], frame.stage_ms[stage]);
+		}
+	}
+
+	std::cout << "Replayed " << m_frames.size() << " frames (" << m_skipped << " skipped), "
+		<< mismatches << " mismatched\n";
+
+	const double frame_count = static_cast<double>(std::max<size_t>(m_frames.size(), 1));
+	for (int stage = 0; stage < StageCount; ++stage)
+	{
+		std::cout << "  " << STAGE_NAMES[stage] << ": avg " << total[stage] / frame_count << " ms, max " << peak[stage] << " ms\n";
+	}
+
+	for (const FrameStats& frame : m_frames)
+	{
+		if (!frame.match)
+			std::cout << "  frame " << frame.frame << " differs\n";
+	}
+
+	if (!m_frames.empty())
+		std::cout << "Final hash " << std::hex << m_frames.back().hash << std::dec << "\n";
+
+	if (csv_path.empty())
+		return;
+
+	std::ofstream csv(csv_path, std::ios::trunc);
+	if (!csv)
+	{
+		std::cerr << "Replay: failed to open " << csv_path << "\n";
+		return;
+	}
+
+	csv << "frame,project_ms,bin_ms,raster_ms,present_ms,hash,match\n";
+	for (const FrameStats& frame : m_frames)
+	{
+		csv << frame.frame;
+		for (int stage = 0; stage < StageCount; ++stage)
+		{
+			csv << "," << frame.stage_ms[stage];
+		}
+		csv << "," << std::hex << frame.hash << std::dec << "," << (frame.match ? 1 : 0) << "\n";
+	}
+}
@@ -0,0 +1,91 @@
+﻿#pragma once
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "frame_capture.hpp"
+#include "renderer.hpp"
+#include "bin_rasterizer.hpp"
+#include "projection.hpp"
+
+// Replays a FrameCapture without the application: projection inputs go through ProjectRange
+// (ProjectQuantizedRange for point cloud chunks), draw calls through a fresh Renderer / BinRasterizer
+// of the captured size and format.
+// Every presented image is hashed against the capture, so two builds or two --cpu paths
+// can be compared on exactly the same frames, and each stage is timed on its own
+class FrameReplayer
+{
+public:
+	enum Stage
+	{
+		StageProject,
+		StageBin,
+		StageRaster,
+		StagePresent,
+		StageCount
+	};
+
+	// Writes one line per frame to csv_path when it is not empty. False if the capture
+	// could not be read or any frame's hash differs
+	bool Run(const std::string& capture_path, const std::string& csv_path = std::string());
+
+private:
+	struct FrameStats
+	{
+		uint32_t frame = 0;
+		double stage_ms[StageCount] = {};
+		uint64_t hash = 0;
+		bool match = true;
+	};
+
+	bool Replay(FrameCaptureReader& reader, CaptureRecord type);
+
+	bool ReplayPositions(FrameCaptureReader& reader);
+	bool ReplayQuantizedPositions(FrameCaptureReader& reader);
+	bool ReplayProject(FrameCaptureReader& reader);
+	bool ReplayPresent(FrameCaptureReader& reader);
+
+	void EnterStage(int stage);
+	void Report(const std::string& csv_path) const;
+
+private:
+	// How the positions of a chunk were last recorded
+	struct ChunkSource
+	{
+		bool quantized = false;
+		vec3_t origin;
+		vec3_t step;
+	};
+
+private:
+	Renderer m_renderer;
+	BinRasterizer m_binner;
+	std::vector<uint32_t> m_front_buffer;
+
+	// Positions as last recorded, and one projection per captured view
+	std::vector<float> m_xs;
+	std::vector<float> m_ys;
+	std::vector<float> m_zs;
+	std::vector<uint16_t> m_qx;
+	std::vector<uint16_t> m_qy;
+	std::vector<uint16_t> m_qz;
+	std::vector<ChunkSource> m_chunk_sources;
+	std::vector<Projection> m_projections;
+
+	// Array payloads, reused across records
+	std::vector<float> m_values;
+	std::vector<uint16_t> m_quantized_values;
+	std::vector<uint32_t> m_chunks;
+	std::vector<vec2_t> m_points;
+	std::vector<MeshEdge> m_edges;
+	std::vector<AlphaMaskRect> m_mask_rects;
+	std::vector<uint8_t> m_mask;
+
+	int m_stage = StageCount;
+	std::chrono::steady_clock::time_point m_stage_start;
+
+	FrameStats m_current;
+	std::vector<FrameStats> m_frames;
+	uint64_t m_skipped = 0;
+};
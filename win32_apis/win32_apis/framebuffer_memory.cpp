@@ -0,0 +1,181 @@
+﻿#include <new>
+
+#include "framebuffer_memory.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	inline size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+#ifdef _WIN32
+	// MEM_LARGE_PAGES fails unless SeLockMemoryPrivilege is enabled in the process token. Enabling only works
+	// when the account holds the right ("Lock pages in memory" in the local security policy)
+	bool EnableLockMemoryPrivilege()
+	{
+		HANDLE token;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+			return false;
+
+		TOKEN_PRIVILEGES privileges = {};
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+		bool enabled = false;
+		if (LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid))
+		{
+			// Succeeds without granting anything when the account lacks the right, the last error tells
+			enabled = AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS;
+		}
+
+		CloseHandle(token);
+		return enabled;
+	}
+#endif
+
+#ifdef __linux__
+	// 2 MB aligned anonymous mapping for transparent huge pages, over-map then trim both ends
+	void* MapAligned(size_t size, size_t alignment)
+	{
+		void* memory = mmap(nullptr, size + alignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory == MAP_FAILED)
+			return nullptr;
+
+		uint8_t* base = static_cast<uint8_t*>(memory);
+		uint8_t* aligned = reinterpret_cast<uint8_t*>(AlignUp(reinterpret_cast<uintptr_t>(base), alignment));
+
+		if (aligned > base)
+			munmap(base, aligned - base);
+
+		size_t tail = (base + size + alignment) - (aligned + size);
+		if (tail > 0)
+			munmap(aligned + size, tail);
+
+		return aligned;
+	}
+#endif
+}
+
+FramebufferMemory::~FramebufferMemory()
+{
+	Free();
+}
+
+bool FramebufferMemory::Allocate(size_t size, bool huge_pages)
+{
+	Free();
+
+	if (size == 0)
+		return false;
+
+#ifdef _WIN32
+	if (huge_pages)
+	{
+		size_t large_page = GetLargePageMinimum();
+		if (large_page > 0 && EnableLockMemoryPrivilege())
+		{
+			size_t mapped_size = AlignUp(size, large_page);
+			m_memory = VirtualAlloc(nullptr, mapped_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (m_memory)
+			{
+				m_mapped_size = mapped_size;
+				m_huge_pages = true;
+			}
+		}
+	}
+
+	// Committed pages are only backed once touched
+	if (!m_memory)
+	{
+		m_mapped_size = size;
+		m_memory = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+
+	if (m_memory)
+		m_source = Source::Map;
+#elif defined(__linux__)
+	if (huge_pages)
+	{
+		size_t mapped_size = AlignUp(size, FRAMEBUFFER_HUGE_PAGE_SIZE);
+
+		// Reserved hugetlbfs pool first, it guarantees the pages
+		void* memory = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory == MAP_FAILED)
+		{
+			// Transparent huge pages, the kernel backs aligned 2 MB ranges on fault when it can
+			memory = MapAligned(mapped_size, FRAMEBUFFER_HUGE_PAGE_SIZE);
+			if (memory)
+				madvise(memory, mapped_size, MADV_HUGEPAGE);
+		}
+
+		if (memory && memory != MAP_FAILED)
+		{
+			m_memory = memory;
+			m_mapped_size = mapped_size;
+			m_huge_pages = true;
+		}
+	}
+
+	if (!m_memory)
+	{
+		size_t mapped_size = AlignUp(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+		void* memory = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (memory != MAP_FAILED)
+		{
+			m_memory = memory;
+			m_mapped_size = mapped_size;
+		}
+	}
+
+	if (m_memory)
+		m_source = Source::Map;
+#endif
+
+	if (!m_memory)
+	{
+		m_memory = ::operator new(size, std::align_val_t(FRAMEBUFFER_ALIGNMENT), std::nothrow);
+		m_mapped_size = size;
+		m_huge_pages = false;
+
+		if (!m_memory)
+			return false;
+
+		m_source = Source::Heap;
+	}
+
+	m_size = size;
+	return true;
+}
+
+void FramebufferMemory::Free()
+{
+	if (!m_memory)
+		return;
+
+	if (m_source == Source::Heap)
+	{
+		::operator delete(m_memory, std::align_val_t(FRAMEBUFFER_ALIGNMENT));
+	}
+	else
+	{
+#ifdef _WIN32
+		VirtualFree(m_memory, 0, MEM_RELEASE);
+#elif defined(__linux__)
+		munmap(m_memory, m_mapped_size);
+#endif
+	}
+
+	m_memory = nullptr;
+	m_size = 0;
+	m_mapped_size = 0;
+	m_source = Source::None;
+	m_huge_pages = false;
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+class JobSystem;
+
+// Heap fallback alignment, OS allocations are at least page aligned
+#define FRAMEBUFFER_ALIGNMENT 64
+#define FRAMEBUFFER_HUGE_PAGE_SIZE (2u * 1024u * 1024u)
+
+struct FramebufferMemoryOptions
+{
+	// 2 MB pages: MAP_HUGETLB, then transparent huge pages (madvise), MEM_LARGE_PAGES on Windows
+	// (enables SeLockMemoryPrivilege, the account needs the "Lock pages in memory" right).
+	// Falls back to normal pages when the OS refuses
+	bool huge_pages = false;
+
+	// Fault the buffer in from these workers instead of the initializing thread, so pages land on the
+	// NUMA nodes of the threads that rasterize them rather than all on one socket
+	JobSystem* first_touch = nullptr;
+
+	// Rows per first touch job, one BinRasterizer tile row by default
+	int band_rows = 64;
+};
+
+// Framebuffer sized block straight from the OS. Pages stay untouched until first written,
+// which is what lets first touch decide their placement
+class FramebufferMemory
+{
+public:
+	FramebufferMemory() = default;
+	~FramebufferMemory();
+
+	FramebufferMemory(const FramebufferMemory&) = delete;
+	FramebufferMemory& operator=(const FramebufferMemory&) = delete;
+
+public:
+	bool Allocate(size_t size, bool huge_pages);
+	void Free();
+
+	void* Get() const { return m_memory; }
+	size_t GetSize() const { return m_size; }
+
+	// True if huge pages were granted (or, for transparent huge pages, requested)
+	bool UsesHugePages() const { return m_huge_pages; }
+
+private:
+	enum class Source : uint8_t
+	{
+		None,
+		Map,		// mmap / VirtualAlloc
+		Heap		// Aligned operator new
+	};
+
+	void* m_memory = nullptr;
+	size_t m_size = 0;
+	size_t m_mapped_size = 0;
+	Source m_source = Source::None;
+	bool m_huge_pages = false;
+};
@@ -0,0 +1,209 @@
+﻿#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "glyph_atlas.hpp"
+
+#define FONT_WIDTH 5
+#define FONT_HEIGHT 7
+#define ATLAS_COLUMNS 16
+
+namespace
+{
+	// One byte per row, bit 4 is the leftmost column
+	const uint8_t FONT_5X7[GLYPH_LAST - GLYPH_FIRST + 1][FONT_HEIGHT] =
+	{
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// space
+		{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 },	// !
+		{ 0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00 },	// "
+		{ 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A },	// #
+		{ 0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04 },	// $
+		{ 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },	// %
+		{ 0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D },	// &
+		{ 0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 },	// quote
+		{ 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },	// (
+		{ 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },	// )
+		{ 0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00 },	// *
+		{ 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 },	// +
+		{ 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 },	// ,
+		{ 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 },	// -
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C },	// .
+		{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },	// /
+		{ 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E },	// 0
+		{ 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E },	// 1
+		{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F },	// 2
+		{ 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E },	// 3
+		{ 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 },	// 4
+		{ 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E },	// 5
+		{ 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E },	// 6
+		{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },	// 7
+		{ 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E },	// 8
+		{ 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C },	// 9
+		{ 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 },	// :
+		{ 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 },	// ;
+		{ 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 },	// <
+		{ 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 },	// =
+		{ 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 },	// >
+		{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 },	// ?
+		{ 0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E },	// @
+		{ 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 },	// A
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E },	// B
+		{ 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E },	// C
+		{ 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C },	// D
+		{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F },	// E
+		{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 },	// F
+		{ 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F },	// G
+		{ 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 },	// H
+		{ 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },	// I
+		{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C },	// J
+		{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },	// K
+		{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F },	// L
+		{ 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 },	// M
+		{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },	// N
+		{ 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },	// O
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 },	// P
+		{ 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D },	// Q
+		{ 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 },	// R
+		{ 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E },	// S
+		{ 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	// T
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E },	// U
+		{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 },	// V
+		{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A },	// W
+		{ 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 },	// X
+		{ 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 },	// Y
+		{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F },	// Z
+		{ 0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E },	// [
+		{ 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 },	// backslash
+		{ 0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E },	// ]
+		{ 0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00 },	// ^
+		{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F },	// _
+		{ 0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00 },	// `
+		{ 0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F },	// a
+		{ 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E },	// b
+		{ 0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E },	// c
+		{ 0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F },	// d
+		{ 0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E },	// e
+		{ 0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08 },	// f
+		{ 0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x0E },	// g
+		{ 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11 },	// h
+		{ 0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E },	// i
+		{ 0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0C },	// j
+		{ 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12 },	// k
+		{ 0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E },	// l
+		{ 0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11 },	// m
+		{ 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 },	// n
+		{ 0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E },	// o
+		{ 0x00, 0x00, 0x1E, 0x11, 0x1E, 0x10, 0x10 },	// p
+		{ 0x00, 0x00, 0x0D, 0x13, 0x0F, 0x01, 0x01 },	// q
+		{ 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10 },	// r
+		{ 0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E },	// s
+		{ 0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06 },	// t
+		{ 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D },	// u
+		{ 0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04 },	// v
+		{ 0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A },	// w
+		{ 0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11 },	// x
+		{ 0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E },	// y
+		{ 0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F },	// z
+		{ 0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02 },	// {
+		{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	// |
+		{ 0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08 },	// }
+		{ 0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00 },	// ~
+	};
+
+	// Length of [a0, a1) inside [b0, b1)
+	inline float Overlap(float a0, float a1, float b0, float b1)
+	{
+		return std::max(std::min(a1, b1) - std::max(a0, b0), 0.0f);
+	}
+}
+
+bool GlyphAtlas::Build(int pixel_height)
+{
+	if (pixel_height < FONT_HEIGHT || pixel_height > 255)
+	{
+		std::cerr << "Glyph atlas: unsupported pixel height " << pixel_height << "\n";
+		return false;
+	}
+
+	// Every source pixel becomes a scale x scale square
+	const float scale = pixel_height / static_cast<float>(FONT_HEIGHT);
+	const int cell_width = static_cast<int>(std::ceil(FONT_WIDTH * scale - 0.001f));
+	const int cell_height = pixel_height;
+	const int spacing = std::max(static_cast<int>(std::lround(scale)), 1);
+
+	const int glyph_count = GLYPH_LAST - GLYPH_FIRST + 1;
+	const int rows = (glyph_count + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+
+	// One empty pixel between cells
+	m_width = ATLAS_COLUMNS * (cell_width + 1);
+	m_height = rows * (cell_height + 1);
+	m_pixels.assign(static_cast<size_t>(m_width) * m_height, 0);
+	m_pixel_height = pixel_height;
+	m_line_height = cell_height + 2 * spacing;
+
+	for (int glyph = 0; glyph < glyph_count; ++glyph)
+	{
+		const int cell_x = (glyph % ATLAS_COLUMNS) * (cell_width + 1);
+		const int cell_y = (glyph / ATLAS_COLUMNS) * (cell_height + 1);
+		const uint8_t* bits = FONT_5X7[glyph];
+
+		int min_x = cell_width, min_y = cell_height, max_x = -1, max_y = -1;
+
+		for (int y = 0; y < cell_height; ++y)
+		{
+			for (int x = 0; x < cell_width; ++x)
+			{
+				// Box filter: the covered area of this target pixel
+				float area = 0.0f;
+				for (int sy = 0; sy < FONT_HEIGHT; ++sy)
+				{
+					const float height = Overlap(static_cast<float>(y), y + 1.0f, sy * scale, (sy + 1) * scale);
+					if (height <= 0.0f)
+						continue;
+
+					for (int sx = 0; sx < FONT_WIDTH; ++sx)
+					{
+						if (bits[sy] & (0x10 >> sx))
+							area += height * Overlap(static_cast<float>(x), x + 1.0f, sx * scale, (sx + 1) * scale);
+					}
+				}
+
+				const int coverage = std::min(static_cast<int>(std::lround(area * 255.0f)), 255);
+				if (coverage == 0)
+					continue;
+
+				m_pixels[static_cast<size_t>(cell_y + y) * m_width + cell_x + x] = static_cast<uint8_t>(coverage);
+				min_x = std::min(min_x, x);
+				min_y = std::min(min_y, y);
+				max_x = std::max(max_x, x);
+				max_y = std::max(max_y, y);
+			}
+		}
+
+		GlyphInfo& info = m_glyphs[glyph];
+		info = {};
+		info.advance = static_cast<uint16_t>(cell_width + spacing);
+
+		// Blank glyphs only advance the pen
+		if (max_x < 0)
+			continue;
+
+		info.atlas_x = static_cast<uint16_t>(cell_x + min_x);
+		info.atlas_y = static_cast<uint16_t>(cell_y + min_y);
+		info.width = static_cast<uint16_t>(max_x - min_x + 1);
+		info.height = static_cast<uint16_t>(max_y - min_y + 1);
+		info.offset_x = static_cast<uint16_t>(min_x);
+		info.offset_y = static_cast<uint16_t>(min_y);
+	}
+
+	return true;
+}
+
+const GlyphInfo& GlyphAtlas::GetGlyph(char c) const
+{
+	const int code = static_cast<unsigned char>(c);
+	if (code < GLYPH_FIRST || code > GLYPH_LAST)
+		return m_glyphs['?' - GLYPH_FIRST];
+
+	return m_glyphs[code - GLYPH_FIRST];
+}
@@ -0,0 +1,48 @@
+﻿#pragma once
+#include <stdint.h>
+#include <vector>
+
+// Printable ASCII, anything else is drawn as '?'
+#define GLYPH_FIRST 32
+#define GLYPH_LAST 126
+
+struct GlyphInfo
+{
+	// Tight rect of the glyph's coverage in the atlas, empty for blank glyphs (space)
+	uint16_t atlas_x;
+	uint16_t atlas_y;
+	uint16_t width;
+	uint16_t height;
+
+	// Rect position relative to the pen, y down from the top of the line
+	uint16_t offset_x;
+	uint16_t offset_y;
+	uint16_t advance;
+};
+
+// Built-in 5x7 bitmap font rasterized once into one 8-bit coverage image. Non-integer scales are box
+// filtered, so every size gets anti-aliased edges instead of uneven pixel doubling
+class GlyphAtlas
+{
+public:
+	// pixel_height is the cell height, 7 and its multiples are pixel exact
+	bool Build(int pixel_height);
+
+	const GlyphInfo& GetGlyph(char c) const;
+
+	const uint8_t* GetPixels() const { return m_pixels.data(); }
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+
+	int GetPixelHeight() const { return m_pixel_height; }
+	int GetLineHeight() const { return m_line_height; }
+
+private:
+	std::vector<uint8_t> m_pixels;
+	int m_width = 0;
+	int m_height = 0;
+	int m_pixel_height = 0;
+	int m_line_height = 0;
+
+	GlyphInfo m_glyphs[GLYPH_LAST - GLYPH_FIRST + 1] = {};
+};
@@ -0,0 +1,11 @@
+﻿#pragma once
+#include <stdint.h>
+
+// Receives finished frames next to (or instead of) the window and file outputs
+class IFrameSink {
+public:
+	virtual ~IFrameSink() {}
+
+	// pixels are 0xAARRGGBB row major, returns false if the frame was dropped
+	virtual bool PublishFrame(const uint32_t* pixels, int width, int height) = 0;
+};
@@ -0,0 +1,459 @@
+﻿#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "image_encoder.hpp"
+
+#define DEFLATE_HASH_BITS 15		// LZ77 match finder head table size
+#define DEFLATE_WINDOW 32768
+
+namespace
+{
+	inline void PutU32BE(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	struct Crc32Table
+	{
+		uint32_t entries[256];
+
+		Crc32Table()
+		{
+			for (uint32_t n = 0; n < 256; ++n)
+			{
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				entries[n] = c;
+			}
+		}
+	};
+
+	uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+	{
+		// Encoders run on several threads, the static local is initialized once
+		static const Crc32Table table;
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+		return ~crc;
+	}
+
+	void PutPNGChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size)
+	{
+		PutU32BE(out, static_cast<uint32_t>(size));
+
+		size_t type_offset = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data, data + size);
+
+		PutU32BE(out, Crc32(out.data() + type_offset, size + 4));
+	}
+
+	// Sums are reduced once per 5552 bytes, the longest run that cannot overflow 32 bits (as in zlib)
+	uint32_t Adler32(const uint8_t* data, size_t size)
+	{
+		uint32_t s1 = 1;
+		uint32_t s2 = 0;
+
+		while (size > 0)
+		{
+			const size_t block = std::min<size_t>(size, 5552);
+			for (size_t i = 0; i < block; ++i)
+			{
+				s1 += data[i];
+				s2 += s1;
+			}
+
+			s1 %= 65521;
+			s2 %= 65521;
+			data += block;
+			size -= block;
+		}
+
+		return (s2 << 16) | s1;
+	}
+
+	// Deflate packs bits LSB first, Huffman codes go in reversed
+	class DeflateBitWriter
+	{
+	public:
+		explicit DeflateBitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+		void Put(uint32_t value, int count)
+		{
+			m_bits |= static_cast<uint64_t>(value) << m_count;
+			m_count += count;
+
+			while (m_count >= 8)
+			{
+				m_out.push_back(static_cast<uint8_t>(m_bits));
+				m_bits >>= 8;
+				m_count -= 8;
+			}
+		}
+
+		void Flush()
+		{
+			if (m_count > 0)
+				m_out.push_back(static_cast<uint8_t>(m_bits));
+
+			m_bits = 0;
+			m_count = 0;
+		}
+
+	private:
+		std::vector<uint8_t>& m_out;
+		uint64_t m_bits = 0;
+		int m_count = 0;
+	};
+
+	const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769,
+		1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// Fixed Huffman codes of RFC 1951 3.2.6 (bit reversed) and match length / distance to code lookups
+	struct FixedHuffmanTable
+	{
+		uint16_t literal_codes[288];
+		uint8_t literal_lengths[288];
+		uint8_t distance_codes[30];
+		uint8_t length_index[259];		// Match length to LENGTH_BASE index
+		uint8_t distance_index[32769];	// Match distance to DISTANCE_BASE index
+
+		static uint32_t Reverse(uint32_t code, int length)
+		{
+			uint32_t reversed = 0;
+			for (int i = 0; i < length; ++i)
+			{
+				reversed = (reversed << 1) | (code & 1);
+				code >>= 1;
+			}
+			return reversed;
+		}
+
+		FixedHuffmanTable()
+		{
+			for (uint32_t symbol = 0; symbol < 288; ++symbol)
+			{
+				uint32_t code, length;
+				if (symbol < 144)      { code = 0x30 + symbol;          length = 8; }
+				else if (symbol < 256) { code = 0x190 + symbol - 144;   length = 9; }
+				else if (symbol < 280) { code = symbol - 256;           length = 7; }
+				else                   { code = 0xC0 + symbol - 280;    length = 8; }
+
+				literal_codes[symbol] = static_cast<uint16_t>(Reverse(code, length));
+				literal_lengths[symbol] = static_cast<uint8_t>(length);
+			}
+
+			for (uint32_t code = 0; code < 30; ++code)
+				distance_codes[code] = static_cast<uint8_t>(Reverse(code, 5));
+
+			for (int length = 3, index = 0; length <= 258; ++length)
+			{
+				while (index < 28 && length >= LENGTH_BASE[index + 1])
+					++index;
+				length_index[length] = static_cast<uint8_t>(index);
+			}
+
+			for (int distance = 1, index = 0; distance <= 32768; ++distance)
+			{
+				while (index < 29 && distance >= DISTANCE_BASE[index + 1])
+					++index;
+				distance_index[distance] = static_cast<uint8_t>(index);
+			}
+		}
+	};
+
+	inline uint32_t HashTriple(const uint8_t* data)
+	{
+		const uint32_t triple = (static_cast<uint32_t>(data[0]) << 16) | (static_cast<uint32_t>(data[1]) << 8) | data[2];
+		return (triple * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+	}
+
+	// One fixed Huffman block, greedy LZ77 with one candidate per hash. Frames are mostly flat
+	// background and repeated sprites, so this already finds the long matches that matter
+	void DeflateFixed(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+	{
+		static const FixedHuffmanTable table;
+
+		DeflateBitWriter bits(out);
+		bits.Put(1, 1);		// Final block
+		bits.Put(1, 2);		// Fixed Huffman
+
+		auto put_symbol = [&](uint32_t symbol) { bits.Put(table.literal_codes[symbol], table.literal_lengths[symbol]); };
+
+		// Last position + 1 per hash, 0 is empty
+		std::vector<uint32_t> head(static_cast<size_t>(1) << DEFLATE_HASH_BITS, 0);
+
+		size_t i = 0;
+		while (i < size)
+		{
+			size_t match_length = 0;
+			size_t match_distance = 0;
+
+			if (i + 3 <= size)
+			{
+				uint32_t& slot = head[HashTriple(data + i)];
+				const size_t candidate = slot;
+				slot = static_cast<uint32_t>(i + 1);
+
+				if (candidate > 0 && i - (candidate - 1) <= DEFLATE_WINDOW)
+				{
+					const uint8_t* previous = data + candidate - 1;
+					const size_t limit = std::min<size_t>(258, size - i);
+
+					size_t length = 0;
+					while (length < limit && previous[length] == data[i + length])
+						++length;
+
+					if (length >= 3)
+					{
+						match_length = length;
+						match_distance = i - (candidate - 1);
+					}
+				}
+			}
+
+			if (match_length == 0)
+			{
+				put_symbol(data[i]);
+				++i;
+				continue;
+			}
+
+			const int length_index = table.length_index[match_length];
+			put_symbol(257 + length_index);
+			bits.Put(static_cast<uint32_t>(match_length - LENGTH_BASE[length_index]), LENGTH_EXTRA[length_index]);
+
+			const int distance_index = table.distance_index[match_distance];
+			bits.Put(table.distance_codes[distance_index], 5);
+			bits.Put(static_cast<uint32_t>(match_distance - DISTANCE_BASE[distance_index]), DISTANCE_EXTRA[distance_index]);
+
+			// Positions inside the match are indexed too, so the next run of background finds this one
+			for (size_t j = i + 1; j < i + match_length && j + 3 <= size; ++j)
+				head[HashTriple(data + j)] = static_cast<uint32_t>(j + 1);
+
+			i += match_length;
+		}
+
+		put_symbol(256);
+		bits.Flush();
+	}
+
+	void DeflateStored(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+	{
+		const size_t max_block = 65535;
+
+		size_t offset = 0;
+		do
+		{
+			size_t block = std::min(max_block, size - offset);
+			bool last = offset + block == size;
+
+			out.push_back(last ? 1 : 0);
+			out.push_back(static_cast<uint8_t>(block));
+			out.push_back(static_cast<uint8_t>(block >> 8));
+			out.push_back(static_cast<uint8_t>(~block));
+			out.push_back(static_cast<uint8_t>(~block >> 8));
+			out.insert(out.end(), data + offset, data + offset + block);
+
+			offset += block;
+		} while (offset < size);
+	}
+
+	struct QOIPixel
+	{
+		uint8_t r, g, b, a;
+
+		bool operator==(const QOIPixel& other) const
+		{
+			return r == other.r && g == other.g && b == other.b && a == other.a;
+		}
+	};
+}
+
+ImageFormat ImageFormatFromPath(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	std::string extension = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+	if (extension == "ppm") return ImageFormat::PPM;
+	if (extension == "png") return ImageFormat::PNG;
+	if (extension == "qoi") return ImageFormat::QOI;
+
+	return ImageFormat::RawVideo;
+}
+
+void EncodeImage(ImageFormat format, const uint32_t* pixels, int width, int height, std::vector<uint8_t>& out)
+{
+	switch (format)
+	{
+	case ImageFormat::PPM:
+		EncodePPM(pixels, width, height, out);
+		break;
+	case ImageFormat::PNG:
+		EncodePNG(pixels, width, height, out);
+		break;
+	case ImageFormat::QOI:
+		EncodeQOI(pixels, width, height, out);
+		break;
+	default:
+		// Little endian 0xAARRGGBB is B, G, R, A in memory
+		out.resize(static_cast<size_t>(width) * height * sizeof(uint32_t));
+		std::memcpy(out.data(), pixels, out.size());
+		break;
+	}
+}
+
+void EncodePPM(const uint32_t* pixels, int width, int height, std::vector<uint8_t>& out)
+{
+	std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+	const size_t count = static_cast<size_t>(width) * height;
+
+	out.resize(header.size() + count * 3);
+	std::memcpy(out.data(), header.data(), header.size());
+
+	uint8_t* dst = out.data() + header.size();
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t color = pixels[i];
+		*dst++ = (color >> 16) & 0xFF;
+		*dst++ = (color >> 8) & 0xFF;
+		*dst++ = color & 0xFF;
+	}
+}
+
+void EncodePNG(const uint32_t* pixels, int width, int height, std::vector<uint8_t>& out)
+{
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	out.assign(signature, signature + 8);
+
+	// 8 bit RGB, deflate, adaptive filtering, no interlace
+	std::vector<uint8_t> header;
+	PutU32BE(header, static_cast<uint32_t>(width));
+	PutU32BE(header, static_cast<uint32_t>(height));
+	header.insert(header.end(), { 8, 2, 0, 0, 0 });
+	PutPNGChunk(out, "IHDR", header.data(), header.size());
+
+	// Scanlines with filter type 0
+	const size_t row_size = static_cast<size_t>(width) * 3 + 1;
+	std::vector<uint8_t> raw(row_size * height);
+	for (int y = 0; y < height; ++y)
+	{
+		uint8_t* dst = raw.data() + row_size * y;
+		const uint32_t* src = pixels + static_cast<size_t>(y) * width;
+
+		*dst++ = 0;
+		for (int x = 0; x < width; ++x)
+		{
+			*dst++ = (src[x] >> 16) & 0xFF;
+			*dst++ = (src[x] >> 8) & 0xFF;
+			*dst++ = src[x] & 0xFF;
+		}
+	}
+
+	// zlib stream, fixed Huffman unless noise made stored blocks smaller, Adler-32 trailer
+	const size_t stored_size = raw.size() + (raw.size() / 65535 + 1) * 5;
+	std::vector<uint8_t> zlib = { 0x78, 0x01 };
+	zlib.reserve(stored_size + 6);
+
+	DeflateFixed(raw.data(), raw.size(), zlib);
+	if (zlib.size() - 2 > stored_size)
+	{
+		zlib.resize(2);
+		DeflateStored(raw.data(), raw.size(), zlib);
+	}
+
+	PutU32BE(zlib, Adler32(raw.data(), raw.size()));
+
+	PutPNGChunk(out, "IDAT", zlib.data(), zlib.size());
+	PutPNGChunk(out, "IEND", nullptr, 0);
+}
+
+void EncodeQOI(const uint32_t* pixels, int width, int height, std::vector<uint8_t>& out)
+{
+	const size_t count = static_cast<size_t>(width) * height;
+
+	out.clear();
+	out.reserve(14 + count * 4 + 8);
+	out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+	PutU32BE(out, static_cast<uint32_t>(width));
+	PutU32BE(out, static_cast<uint32_t>(height));
+	out.push_back(3);	// RGB
+	out.push_back(0);	// sRGB
+
+	QOIPixel index[64] = {};
+	QOIPixel previous = { 0, 0, 0, 255 };
+	int run = 0;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t color = pixels[i];
+		QOIPixel pixel = {
+			static_cast<uint8_t>(color >> 16),
+			static_cast<uint8_t>(color >> 8),
+			static_cast<uint8_t>(color),
+			255
+		};
+
+		if (pixel == previous)
+		{
+			if (++run == 62 || i + 1 == count)
+			{
+				out.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+				run = 0;
+			}
+			continue;
+		}
+
+		if (run > 0)
+		{
+			out.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+			run = 0;
+		}
+
+		int hash = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+		if (index[hash] == pixel)
+		{
+			out.push_back(static_cast<uint8_t>(hash));
+		}
+		else
+		{
+			index[hash] = pixel;
+
+			int8_t dr = static_cast<int8_t>(pixel.r - previous.r);
+			int8_t dg = static_cast<int8_t>(pixel.g - previous.g);
+			int8_t db = static_cast<int8_t>(pixel.b - previous.b);
+			int dr_dg = dr - dg;
+			int db_dg = db - dg;
+
+			if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2)
+			{
+				out.push_back(static_cast<uint8_t>(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+			}
+			else if (dr_dg > -9 && dr_dg < 8 && dg > -33 && dg < 32 && db_dg > -9 && db_dg < 8)
+			{
+				out.push_back(static_cast<uint8_t>(0x80 | (dg + 32)));
+				out.push_back(static_cast<uint8_t>(((dr_dg + 8) << 4) | (db_dg + 8)));
+			}
+			else
+			{
+				out.insert(out.end(), { 0xFE, pixel.r, pixel.g, pixel.b });
+			}
+		}
+
+		previous = pixel;
+	}
+
+	out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+}
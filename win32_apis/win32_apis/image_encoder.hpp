@@ -0,0 +1,22 @@
+﻿#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum class ImageFormat : uint8_t
+{
+	PPM,		// Binary P6, uncompressed RGB
+	PNG,		// RGB, one fixed Huffman deflate block (no zlib dependency)
+	QOI,		// RGB, "Quite OK Image" lossless compression
+	RawVideo	// Frames appended to one stream as BGRA (ffmpeg -f rawvideo -pix_fmt bgra)
+};
+
+// Guesses the format from the extension (.ppm, .png, .qoi, anything else is raw video)
+ImageFormat ImageFormatFromPath(const std::string& path);
+
+// pixels are 0xAARRGGBB row major, out is overwritten with the encoded file
+void EncodeImage(ImageFormat format, const uint32_t* pixels, int width, int height, std::vector<uint8_t>& out);
+
+void EncodePPM(const uint32_t* pixels, int width, int height, std::vector<uint8_t>& out);
+void EncodePNG(const uint32_t* pixels, int width, int height, std::vector<uint8_t>& out);
+void EncodeQOI(const uint32_t* pixels, int width, int height, std::vector<uint8_t>& out);
@@ -0,0 +1,16 @@
+﻿#pragma once
+
+#include "pixel_format.hpp"
+
+// The presented 32-bit ARGB image
+typedef FramebufferView<PixelARGB8888, LinearLayout> OverlayView;
+
+// Drawn on top of every presented frame, see Renderer::SetOverlay
+class IRenderOverlay {
+public:
+	virtual ~IRenderOverlay() {}
+
+	// Draw into target with the kernels (draw_kernels.hpp). The back buffer keeps only the scene
+	// and captures never see the overlay
+	virtual void DrawOverlay(const OverlayView& target) = 0;
+};
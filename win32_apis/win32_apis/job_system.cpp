@@ -0,0 +1,142 @@
+﻿#include <algorithm>
+
+#include "job_system.hpp"
+
+namespace
+{
+	// Pool whose chunks the current thread is running, nested ParallelFor calls on it run inline
+	thread_local const JobSystem* t_running_pool = nullptr;
+}
+
+JobSystem::JobSystem(int worker_count) : m_next_chunk(0), m_chunks_done(0)
+{
+	if (worker_count <= 0)
+		worker_count = std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 0);
+
+	for (int i = 0; i < worker_count; ++i)
+	{
+		m_workers.emplace_back(&JobSystem::WorkerLoop, this);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+JobSystem& JobSystem::GetInstance()
+{
+	static JobSystem instance;
+	return instance;
+}
+
+void JobSystem::ParallelFor(size_t count, size_t chunk_size, const std::function<void(size_t, size_t)>& fn)
+{
+	if (count == 0)
+		return;
+
+	chunk_size = std::max<size_t>(chunk_size, 1);
+	const size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+
+	// Not worth waking anyone. Called from inside one of our jobs: the workers are busy with the outer loop
+	// and m_dispatch_mutex is held, so the caller runs the whole range itself
+	if (chunk_count == 1 || m_workers.empty() || t_running_pool == this)
+	{
+		fn(0, count);
+		return;
+	}
+
+	std::lock_guard<std::mutex> dispatch_lock(m_dispatch_mutex);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &fn;
+		m_count = count;
+		m_chunk_size = chunk_size;
+		m_chunk_count = chunk_count;
+		m_next_chunk = 0;
+		m_chunks_done = 0;
+		++m_generation;
+	}
+	m_wake.notify_all();
+
+	RunChunks(fn, count, chunk_size, chunk_count);
+
+	// Workers only join while chunks are left, so once everything is done and nobody is busy
+	// no thread can still touch fn
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_chunks_done == m_chunk_count && m_busy_workers == 0; });
+	m_task = nullptr;
+}
+
+void JobSystem::RunChunks(const std::function<void(size_t, size_t)>& fn, size_t count, size_t chunk_size, size_t chunk_count)
+{
+	const JobSystem* outer_pool = t_running_pool;
+	t_running_pool = this;
+
+	for (;;)
+	{
+		size_t chunk = m_next_chunk.fetch_add(1);
+		if (chunk >= chunk_count)
+			break;
+
+		size_t begin = chunk * chunk_size;
+		fn(begin, std::min(begin + chunk_size, count));
+
+		if (m_chunks_done.fetch_add(1) + 1 == chunk_count)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_done.notify_all();
+		}
+	}
+
+	t_running_pool = outer_pool;
+}
+
+void JobSystem::WorkerLoop()
+{
+	uint64_t seen_generation = 0;
+
+	for (;;)
+	{
+		const std::function<void(size_t, size_t)>* task = nullptr;
+		size_t count = 0;
+		size_t chunk_size = 0;
+		size_t chunk_count = 0;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_quit || m_generation != seen_generation; });
+
+			if (m_quit)
+				return;
+
+			seen_generation = m_generation;
+			if (!m_task || m_next_chunk >= m_chunk_count)
+				continue;
+
+			task = m_task;
+			count = m_count;
+			chunk_size = m_chunk_size;
+			chunk_count = m_chunk_count;
+			++m_busy_workers;
+		}
+
+		RunChunks(*task, count, chunk_size, chunk_count);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_busy_workers;
+		}
+		m_done.notify_all();
+	}
+}
@@ -0,0 +1,55 @@
+﻿#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads for data parallel loops. The calling thread takes part in the work
+class JobSystem
+{
+public:
+	// 0 = one worker per core besides the calling thread
+	explicit JobSystem(int worker_count = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+public:
+	// Calls fn(begin, end) over [0, count) in chunk_size pieces and returns once all of them ran.
+	// Calls from several threads are serialized, calls from inside fn run inline on the calling thread
+	void ParallelFor(size_t count, size_t chunk_size, const std::function<void(size_t, size_t)>& fn);
+
+	int GetWorkerCount() const { return static_cast<int>(m_workers.size()); }
+
+	// Shared pool sized to the machine, created on first use
+	static JobSystem& GetInstance();
+
+private:
+	void WorkerLoop();
+	void RunChunks(const std::function<void(size_t, size_t)>& fn, size_t count, size_t chunk_size, size_t chunk_count);
+
+private:
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_dispatch_mutex;		// One ParallelFor at a time
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	// Current task, written under m_mutex
+	const std::function<void(size_t, size_t)>* m_task = nullptr;
+	size_t m_count = 0;
+	size_t m_chunk_size = 0;
+	size_t m_chunk_count = 0;
+	uint64_t m_generation = 0;
+	int m_busy_workers = 0;
+	bool m_quit = false;
+
+	std::atomic<size_t> m_next_chunk;
+	std::atomic<size_t> m_chunks_done;
+};
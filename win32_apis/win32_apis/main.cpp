@@ -1,50 +1,98 @@
 #include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 
 #include "application.hpp"
+#include "batch_renderer.hpp"
+#include "entity_store.hpp"
+#include "job_system.hpp"
+#include "bin_rasterizer.hpp"
+#include "cpu_dispatch.hpp"
+#include "frame_export.hpp"
+#include "frame_replay.hpp"
+#include "mesh.hpp"
+#include "point_cloud.hpp"
 #include "renderer.hpp"
+#include "text_renderer.hpp"
 #include "projection.hpp"
+#include "render_view.hpp"
 #include "vector.h"
 
 #define P_NUMBER (9 * 9 * 9)
 
+// The demo scene: a 9 * 9 * 9 grid of points from -1 to 1
+void AddCubePoints(EntityStore& entities)
+{
+	entities.Reserve(entities.GetCount() + P_NUMBER);
+
+	for (float x = -1; x <= 1; x += 0.25)
+	{
+		for (float y = -1; y <= 1; y += 0.25)
+		{
+			for (float z = -1; z <= 1; z += 0.25)
+			{
+				entities.Create({ x, y, z });
+			}
+
+		}
+	}
+}
+
+// How RuleEngine draws its floor mesh, 'W' cycles through them
+enum class MeshMode : uint8_t
+{
+	Hidden,
+	Solid,
+	Wireframe
+};
+
 class RuleEngine : public Application
 {
 	void Initialize() override
 	{
 		std::cout << "RuleEngine initialized!\n";
 
-		// Load my array of vectors
-		// From -1 to 1 (in this 9 * 9 * 9 array)
-		int number_count = 0;
+		m_entities.Clear();
+		m_cloud.Clear();
 
-		for (float x = -1; x <= 1; x += 0.25)
+		// A point cloud file replaces the cube, a file that fails to load falls back to it
+		if (!m_cloud_path.empty() && m_cloud.Load(m_cloud_path))
 		{
-			for (float y = -1; y <= 1; y += 0.25)
-			{
-				for (float z = -1; z <= 1; z += 0.25)
-				{
-					m_cube_points[number_count++] = { x, y, z };
-				}
-
-			}
+			std::cout << "Point cloud " << m_cloud_path << ": " << m_cloud.GetCount() << " points, "
+				<< m_cloud.GetMemoryBytes() << " bytes\n";
+		}
+		else
+		{
+			AddCubePoints(m_entities);
 		}
 
+		// Floor under the cube, long enough to pass behind the camera so its edges get depth clipped
+		m_floor = BuildGridMesh(16, 16, -4.0f, 4.0f, -8.0f, 8.0f, 1.25f);
+
+		m_text.Initialize(14);
 	}
 
 	void Update(int inDeltaTime) override
 	{
-		for (int i = 0; i < P_NUMBER; i++)
-		{
-			vec3_t point = m_cube_points[i];
-
-			// Move point relative to camera
-			point.z -= camera_position.z;
+		JobSystem& jobs = JobSystem::GetInstance();
+		LayoutViews();
 
-			// Project the current point
-			vec2_t projected_point = m_projection->PerspectiveProject(point);
-
-			m_projection->GetProjectedPoints()[i] = projected_point;
+		// Only chunks with moving points are touched, then every view projects from the same positions.
+		// Points are 4 pixel rectangles, the margin keeps the ones hanging into a viewport
+		if (m_cloud.GetCount() > 0)
+		{
+			// Static, projected straight from the 16-bit coordinates
+			m_cloud.ProjectViews(jobs, m_views.data(), m_views.size(), 8.0f);
+			return;
 		}
+
+		m_entities.Integrate(jobs, inDeltaTime / 1000.0f);
+		m_entities.ProjectViews(jobs, m_views.data(), m_views.size(), 8.0f);
 	}
 
 	void Render(float inAspectRatio) override
@@ -56,25 +104,78 @@ class RuleEngine : public Application
 			return;
 		}
 
-		renderer->ClearColorBuffer(0xFF020202);
-		renderer->DrawGrid(0xFF333333);
+		// Camera and points did not move in any view, the previous image is still valid
+		bool changed = m_views_dirty;
+		for (const RenderView& view : m_views)
+		{
+			changed |= view.projection.HasFrameChanged();
+		}
+
+		if (!changed)
+		{
+			renderer->SkipFrame();
+			return;
+		}
+
+		// Binned: the 729 scattered rectangles are rasterized tile by tile in cache, all views in one flush.
+		// Views that did not change are not binned, their tiles keep last frame's pixels
+		m_binner.Begin(*renderer);
+
+		for (const RenderView& view : m_views)
+		{
+			if (!m_views_dirty && !view.projection.HasFrameChanged())
+				continue;
+
+			m_binner.SetViewport(view.viewport);
+			m_binner.ClearColorBuffer(0xFF020202);
+			m_binner.DrawGrid(0xFF333333);
+
+			const std::vector<vec2_t>& projected_points = view.projection.GetProjectedPoints();
+
+			for (size_t chunk = 0; chunk < view.visible_chunks.size(); chunk++)
+			{
+				if (!view.visible_chunks[chunk])
+					continue;
+
+				size_t first = chunk * ENTITY_CHUNK_SIZE;
+				size_t last = std::min(first + ENTITY_CHUNK_SIZE, projected_points.size());
+
+				for (size_t i = first; i < last; i++)
+				{
+					const vec2_t point = projected_points[i];
+
+					// Check the Z axis of the point the far the point the color gets darker and get smaller
+
+					m_binner.DrawRectangle(
+						static_cast<int>(point.x) + (view.viewport.width / 2),
+						static_cast<int>(point.y) + (view.viewport.height / 2),
+						4,
+						4,
+						0xFF57A649
+					);
+				}
+			}
+		}
+
+		m_binner.Flush(JobSystem::GetInstance());
 
-		for (int i = 0; i < P_NUMBER; i++)
+		if (m_mesh_mode != MeshMode::Hidden)
+			DrawFloor(*renderer);
+
+		// Labels go on top of the flushed tiles, again only for views that were redrawn
+		for (size_t i = 0; i < m_views.size(); i++)
 		{
-			const vec2_t point = m_projection->GetProjectedPoints()[i];
+			const RenderView& view = m_views[i];
+			if (!m_views_dirty && !view.projection.HasFrameChanged())
+				continue;
 
-			// Check the Z axis of the point the far the point the color gets darker and get smaller
-			
-			renderer->DrawRectangle(
-				static_cast<uint16_t>(point.x) + (renderer->GetBufferWidth() / 2),
-				static_cast<uint16_t>(point.y) + (renderer->GetBufferHeight() / 2),
-				4,
-				4,
-				0xFF57A649
-			);
-		
+			char label[96];
+			std::snprintf(label, sizeof(label), "VIEW %zu\nX %.2f Y %.2f Z %.2f", i + 1,
+				view.camera.position.x, view.camera.position.y, view.camera.position.z);
+			m_text.DrawString(*renderer, view.viewport.x + 6, view.viewport.y + 6, label, 0xC0E0E0E0);
 		}
 
+		m_views_dirty = false;
 	}
 
 	void ShutDown() override
@@ -82,23 +183,440 @@ class RuleEngine : public Application
 		std::cout << "RuleEngine shutting down\n";
 	}
 
+	void SetCameraPosition(const vec3_t& position) override
+	{
+		camera_position = position;
+	}
+
+	void OnKeyDown(int key) override
+	{
+		if (key == 'W')
+		{
+			SetMeshMode(static_cast<MeshMode>((static_cast<int>(m_mesh_mode) + 1) % 3));
+		}
+	}
+
+public:
+	// Split screen: columns x rows cameras side by side, spread around the main camera
+	void SetViewGrid(int columns, int rows)
+	{
+		m_view_columns = std::max(columns, 1);
+		m_view_rows = std::max(rows, 1);
+		m_layout_width = 0;
+	}
+
+	void SetMeshMode(MeshMode mode)
+	{
+		m_mesh_mode = mode;
+		m_views_dirty = true;
+	}
+
+	// Quantized point cloud drawn instead of the cube (see --pack-points)
+	void SetPointCloudPath(const std::string& path) { m_cloud_path = path; }
+
+private:
+	// Drawn straight into the renderer after the flush, only for views that were redrawn
+	void DrawFloor(Renderer& renderer)
+	{
+		for (const RenderView& view : m_views)
+		{
+			if (!m_views_dirty && !view.projection.HasFrameChanged())
+				continue;
+
+			m_floor_camera.resize(m_floor.vertices.size());
+			for (size_t i = 0; i < m_floor.vertices.size(); i++)
+			{
+				const vec3_t& vertex = m_floor.vertices[i];
+				m_floor_camera[i] = vec3_t(vertex.x - view.camera.position.x, vertex.y - view.camera.position.y, vertex.z - view.camera.position.z);
+			}
+
+			if (m_mesh_mode == MeshMode::Wireframe)
+			{
+				renderer.DrawWireframe3D(view.projection, view.viewport, m_floor_camera.data(), m_floor_camera.size(),
+					m_floor.edges.data(), m_floor.edges.size(), 0xFF4A90D9);
+				continue;
+			}
+
+			for (size_t i = 0; i + 2 < m_floor.indices.size(); i += 3)
+			{
+				const vec3_t triangle[3] = { m_floor_camera[m_floor.indices[i]], m_floor_camera[m_floor.indices[i + 1]], m_floor_camera[m_floor.indices[i + 2]] };
+
+				// Checkerboard, both triangles of a quad share a color
+				const size_t quad = i / 6;
+				renderer.DrawTriangle3D(view.projection, view.viewport, triangle, ((quad + quad / 16) % 2) ? 0x803A6EA5 : 0x80284E75);
+			}
+		}
+	}
+
+	void LayoutViews()
+	{
+		Renderer* renderer = GetRenderer();
+		if (!renderer)
+			return;
+
+		const int width = renderer->GetBufferWidth();
+		const int height = renderer->GetBufferHeight();
+
+		if (width != m_layout_width || height != m_layout_height)
+		{
+			std::vector<Viewport> viewports;
+			LayoutViewGrid(width, height, m_view_columns, m_view_rows, viewports);
+
+			m_views.resize(viewports.size());
+			for (size_t i = 0; i < viewports.size(); i++)
+			{
+				m_views[i].viewport = viewports[i];
+			}
+
+			m_layout_width = width;
+			m_layout_height = height;
+			m_views_dirty = true;
+		}
+
+		for (size_t i = 0; i < m_views.size(); i++)
+		{
+			RenderView& view = m_views[i];
+			const float column = static_cast<float>(i % m_view_columns) - (m_view_columns - 1) * 0.5f;
+			const float row = static_cast<float>(i / m_view_columns) - (m_view_rows - 1) * 0.5f;
+
+			// Zoom scales with the viewport so every view frames the whole cube
+			view.camera.position = vec3_t(camera_position.x + column * 0.75f, camera_position.y + row * 0.75f, camera_position.z);
+			view.camera.fov_factor = 1500.0f * view.viewport.height / static_cast<float>(height);
+		}
+	}
+
 private:
-	vec3_t m_cube_points[P_NUMBER];
-	Projection *m_projection = new Projection(static_cast<size_t>(P_NUMBER));
+	EntityStore m_entities;
+	PointCloud m_cloud;
+	std::string m_cloud_path;
+
+	Mesh m_floor;
+	std::vector<vec3_t> m_floor_camera;		// Floor vertices relative to the current view's camera
+	MeshMode m_mesh_mode = MeshMode::Hidden;
+
+	BinRasterizer m_binner;
+	TextRenderer m_text;
+
+	std::vector<RenderView> m_views;
+	int m_view_columns = 1;
+	int m_view_rows = 1;
+	int m_layout_width = 0;
+	int m_layout_height = 0;
+	bool m_views_dirty = true;
 
 	vec3_t camera_position = {0, 0, -5};
 
 };
 
-#if _DEBUG
-#pragma comment(linker, "/subsystem:console")
-
+#if _DEBUG || !defined(_WIN32)
 #ifdef _WIN32
+#pragma comment(linker, "/subsystem:console")
 #pragma comment(lib, "opengl32.lib")
 #endif
-int main()
+// Everything main accepts, flags may come in any order
+struct CommandLine
+{
+	bool help = false;
+
+	std::string cpu_path;				// --cpu scalar|sse41|avx2|avx512
+	std::string replay_path;			// --replay <capture> [stats.csv]
+	std::string replay_stats_path;
+	std::string pack_points_path;		// --pack-points <file> [raw|delta|entropy]
+	PointCloudEncoding pack_encoding = PointCloudEncoding::Entropy;
+
+	bool huge_pages = false;			// --huge-pages
+	bool hud = false;					// --hud
+	int view_columns = 1;				// --views <columns> <rows>
+	int view_rows = 1;
+	std::string capture_path;			// --capture <file>
+	MeshMode mesh_mode = MeshMode::Hidden;	// --mesh solid|wireframe
+	std::string points_path;			// --points <file>
+
+	bool batch = false;					// --batch <frame_count> <output_path>
+	int batch_frames = 0;
+	std::string batch_output;
+	std::string export_name;			// --export <shm_name>, Linux only
+};
+
+void PrintUsage()
+{
+	std::cout <<
+		"Usage: win32_apis [options]\n"
+		"  --cpu scalar|sse41|avx2|avx512     force a kernel path (also RENDERER_CPU_PATH)\n"
+		"  --replay <capture> [stats.csv]     redraw a --capture recording and check every frame's hash\n"
+		"  --pack-points <file> [encoding]    write the demo cube as a point cloud (raw, delta or entropy)\n"
+		"  --huge-pages                       back the framebuffer with 2 MB pages where the OS allows it\n"
+		"  --hud                              draw FPS, frame times and per frame counters over the image\n"
+		"  --views <columns> <rows>           split-screen grid of cameras\n"
+		"  --capture <file>                   record draw calls, projection inputs and input events\n"
+		"  --mesh solid|wireframe             draw a floor mesh under the cube ('W' cycles it)\n"
+		"  --points <file>                    draw a --pack-points cloud instead of the cube\n"
+		"  --batch <frame_count> <output>     render headless; .ppm, .png (deflate) and .qoi per frame, other\n"
+		"                                     extensions one raw BGRA stream, '-' writes nothing\n"
+		"  --export <shm_name>                with --batch, also publish frames to shared memory (Linux)\n";
+}
+
+bool ParseInt(const char* text, int& value)
+{
+	char* end = nullptr;
+	const long parsed = std::strtol(text, &end, 10);
+	if (end == text || *end != '\0' || parsed < 0 || parsed > 1000000000)
+		return false;
+
+	value = static_cast<int>(parsed);
+	return true;
+}
+
+// False after printing what was wrong
+bool ParseCommandLine(int argc, char** argv, CommandLine& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+
+		// Values of arg follow it and never look like a flag, so a missing one is caught instead of swallowing the next flag
+		auto is_value = [&](int index) { return index < argc && std::strncmp(argv[index], "--", 2) != 0; };
+		auto require = [&](int count)
+		{
+			bool present = true;
+			for (int value = 1; value <= count; ++value)
+				present = present && is_value(i + value);
+
+			if (present)
+				return true;
+
+			std::cerr << arg << " needs " << count << (count == 1 ? " argument" : " arguments") << std::endl;
+			return false;
+		};
+		auto has_optional = [&]() { return is_value(i + 1); };
+
+		if (arg == "--help" || arg == "-h")
+		{
+			options.help = true;
+		}
+		else if (arg == "--cpu")
+		{
+			if (!require(1))
+				return false;
+			options.cpu_path = argv[++i];
+		}
+		else if (arg == "--replay")
+		{
+			if (!require(1))
+				return false;
+			options.replay_path = argv[++i];
+			if (has_optional())
+				options.replay_stats_path = argv[++i];
+		}
+		else if (arg == "--pack-points")
+		{
+			if (!require(1))
+				return false;
+			options.pack_points_path = argv[++i];
+			if (has_optional())
+			{
+				const char* encoding = argv[++i];
+				if (!ParsePointCloudEncoding(encoding, options.pack_encoding))
+				{
+					std::cerr << "Unknown point cloud encoding " << encoding << std::endl;
+					return false;
+				}
+			}
+		}
+		else if (arg == "--huge-pages")
+		{
+			options.huge_pages = true;
+		}
+		else if (arg == "--hud")
+		{
+			options.hud = true;
+		}
+		else if (arg == "--views")
+		{
+			if (!require(2))
+				return false;
+			if (!ParseInt(argv[i + 1], options.view_columns) || !ParseInt(argv[i + 2], options.view_rows))
+			{
+				std::cerr << "--views takes two counts, got " << argv[i + 1] << " " << argv[i + 2] << std::endl;
+				return false;
+			}
+			i += 2;
+		}
+		else if (arg == "--capture")
+		{
+			if (!require(1))
+				return false;
+			options.capture_path = argv[++i];
+		}
+		else if (arg == "--mesh")
+		{
+			if (!require(1))
+				return false;
+
+			const std::string mode = argv[++i];
+			if (mode == "solid")
+				options.mesh_mode = MeshMode::Solid;
+			else if (mode == "wireframe")
+				options.mesh_mode = MeshMode::Wireframe;
+			else
+			{
+				std::cerr << "Unknown mesh mode " << mode << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--points")
+		{
+			if (!require(1))
+				return false;
+			options.points_path = argv[++i];
+		}
+		else if (arg == "--batch")
+		{
+			if (!require(2))
+				return false;
+			if (!ParseInt(argv[i + 1], options.batch_frames))
+			{
+				std::cerr << "--batch takes a frame count, got " << argv[i + 1] << std::endl;
+				return false;
+			}
+			options.batch = true;
+			options.batch_output = argv[i + 2];
+			i += 2;
+		}
+		else if (arg == "--export")
+		{
+			if (!require(1))
+				return false;
+			options.export_name = argv[++i];
+		}
+		else
+		{
+			std::cerr << "Unknown argument " << arg << " (--help lists them)" << std::endl;
+			return false;
+		}
+	}
+
+	if (!options.export_name.empty() && !options.batch)
+	{
+		std::cerr << "--export needs --batch" << std::endl;
+		return false;
+	}
+
+#ifndef __linux__
+	if (!options.export_name.empty())
+	{
+		std::cerr << "--export is only available on Linux" << std::endl;
+		return false;
+	}
+#endif
+
+	if (!options.replay_path.empty() && !options.pack_points_path.empty())
+	{
+		std::cerr << "--replay and --pack-points cannot be combined" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
 {
+	CommandLine options;
+	if (!ParseCommandLine(argc, argv, options))
+		return 1;
+
+	if (options.help)
+	{
+		PrintUsage();
+		return 0;
+	}
+
+	// Kernel path first, everything after may already run kernels
+	if (!options.cpu_path.empty())
+	{
+		CpuPath path;
+		if (!ParseCpuPath(options.cpu_path.c_str(), path))
+		{
+			std::cerr << "Unknown CPU path " << options.cpu_path << std::endl;
+			return 1;
+		}
+
+		if (!SelectCpuPath(path))
+			return 1;
+	}
+	std::cout << "CPU path: " << GetCpuPathName(GetCpuKernels().path) << std::endl;
+
+	// e.g. after --cpu to compare kernel paths on identical input
+	if (!options.replay_path.empty())
+	{
+		FrameReplayer replayer;
+		return replayer.Run(options.replay_path, options.replay_stats_path) ? 0 : 1;
+	}
+
+	if (!options.pack_points_path.empty())
+	{
+		EntityStore cube;
+		AddCubePoints(cube);
+
+		PointCloud cloud;
+		cloud.Build(cube.GetPositionsX(), cube.GetPositionsY(), cube.GetPositionsZ(), cube.GetCount());
+		if (!cloud.Save(options.pack_points_path, options.pack_encoding))
+			return 1;
+
+		std::ifstream file(options.pack_points_path, std::ios::binary | std::ios::ate);
+		std::cout << cloud.GetCount() << " points: " << cloud.GetMemoryBytes() << " bytes quantized ("
+			<< cube.GetCount() * 3 * sizeof(float) << " as floats), " << static_cast<long long>(file.tellg())
+			<< " bytes on disk (" << GetPointCloudEncodingName(options.pack_encoding) << ")" << std::endl;
+		return 0;
+	}
+
 	RuleEngine engine;
+	engine.SetHudEnabled(options.hud);
+	engine.SetViewGrid(options.view_columns, options.view_rows);
+	engine.SetMeshMode(options.mesh_mode);
+
+	if (!options.capture_path.empty())
+		engine.SetCapturePath(options.capture_path);
+
+	if (!options.points_path.empty())
+		engine.SetPointCloudPath(options.points_path);
+
+	// Headless, e.g. --batch 1000 frames/frame_#####.qoi
+	if (options.batch)
+	{
+		BatchSettings settings;
+		settings.frame_count = options.batch_frames;
+		settings.output_path = options.batch_output == "-" ? std::string() : options.batch_output;
+		settings.format = ImageFormatFromPath(settings.output_path);
+		settings.huge_pages = options.huge_pages;
+
+#ifdef __linux__
+		// Publishes every frame to shared memory for external viewers/recorders, see SharedFrameReader
+		SharedFrameExporter exporter;
+		if (!options.export_name.empty())
+		{
+			if (!exporter.Create(options.export_name, settings.width, settings.height))
+				return 1;
+			settings.sink = &exporter;
+		}
+#endif
+
+		// Slow orbit with a dolly in and out
+		settings.camera_path = [](int frame)
+		{
+			float t = frame / 60.0f;
+			return vec3_t(std::sin(t) * 0.5f, 0.0f, -5.0f - std::sin(t * 0.5f) * 2.0f);
+		};
+
+		BatchRenderer batch(settings);
+		return batch.Run(engine) ? 0 : 1;
+	}
+
+	FramebufferMemoryOptions memory;
+	memory.huge_pages = options.huge_pages;
+	memory.first_touch = &JobSystem::GetInstance();
+	engine.GetRenderer()->SetMemoryOptions(memory);
+
 	engine.StartWindowed(0, 0, 100, 100, 0);
 	return 0;
 }
@@ -0,0 +1,62 @@
+﻿#include <algorithm>
+
+#include "mesh.hpp"
+
+std::vector<MeshEdge> BuildUniqueEdges(const uint32_t* triangle_indices, size_t index_count)
+{
+	std::vector<MeshEdge> edges;
+	edges.reserve(index_count);
+
+	for (size_t i = 0; i + 2 < index_count; i += 3)
+	{
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			uint32_t a = triangle_indices[i + corner];
+			uint32_t b = triangle_indices[i + (corner + 1) % 3];
+			edges.push_back({ std::min(a, b), std::max(a, b) });
+		}
+	}
+
+	// Sort then unique is cheaper than a hash set for the index counts we build once at load
+	std::sort(edges.begin(), edges.end(), [](const MeshEdge& l, const MeshEdge& r)
+	{
+		return l.a != r.a ? l.a < r.a : l.b < r.b;
+	});
+	edges.erase(std::unique(edges.begin(), edges.end(), [](const MeshEdge& l, const MeshEdge& r)
+	{
+		return l.a == r.a && l.b == r.b;
+	}), edges.end());
+
+	return edges;
+}
+
+Mesh BuildGridMesh(int columns, int rows, float min_x, float max_x, float min_z, float max_z, float height)
+{
+	Mesh mesh;
+	if (columns <= 0 || rows <= 0)
+		return mesh;
+
+	const uint32_t stride = static_cast<uint32_t>(columns) + 1;
+
+	for (int row = 0; row <= rows; ++row)
+	{
+		const float z = min_z + (max_z - min_z) * row / rows;
+		for (int column = 0; column <= columns; ++column)
+		{
+			mesh.vertices.push_back(vec3_t(min_x + (max_x - min_x) * column / columns, height, z));
+		}
+	}
+
+	for (uint32_t row = 0; row < static_cast<uint32_t>(rows); ++row)
+	{
+		for (uint32_t column = 0; column < static_cast<uint32_t>(columns); ++column)
+		{
+			const uint32_t corner = row * stride + column;
+			const uint32_t quad[6] = { corner, corner + 1, corner + stride, corner + 1, corner + stride + 1, corner + stride };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+
+	mesh.edges = BuildUniqueEdges(mesh.indices.data(), mesh.indices.size());
+	return mesh;
+}
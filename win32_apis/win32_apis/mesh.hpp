@@ -0,0 +1,27 @@
+﻿#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "vector.h"
+
+// Index pair into a projected point array, stored with a < b
+struct MeshEdge
+{
+	uint32_t a;
+	uint32_t b;
+};
+
+// Unique edges of an indexed triangle list, edges shared by neighbouring triangles appear once
+std::vector<MeshEdge> BuildUniqueEdges(const uint32_t* triangle_indices, size_t index_count);
+
+// Indexed triangle list, drawn filled or as its unique edges
+struct Mesh
+{
+	std::vector<vec3_t> vertices;
+	std::vector<uint32_t> indices;		// Three per triangle
+	std::vector<MeshEdge> edges;		// BuildUniqueEdges(indices)
+};
+
+// Flat grid in the plane y = height, columns x rows quads of two triangles spanning [min_x, max_x] x [min_z, max_z]
+Mesh BuildGridMesh(int columns, int rows, float min_x, float max_x, float min_z, float max_z, float height);
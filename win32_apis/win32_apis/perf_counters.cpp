@@ -0,0 +1,116 @@
+﻿#include <cstdlib>
+#include <new>
+
+#include "perf_counters.hpp"
+
+std::atomic<bool> PerfCounters::s_enabled(false);
+
+namespace
+{
+	const size_t COUNTER_COUNT = static_cast<size_t>(PerfCounter::Count);
+
+	struct alignas(64) PerfSlot
+	{
+		std::atomic<uint64_t> values[COUNTER_COUNT];
+	};
+
+	// Static storage: handing out a slot never allocates, so operator new below can count too
+	PerfSlot s_slots[PERF_MAX_THREADS];
+	PerfSlot s_shared_slot;
+	std::atomic<uint32_t> s_slot_count(0);
+
+	thread_local PerfSlot* t_slot = nullptr;
+	thread_local int t_suppressed = 0;
+
+	PerfSlot& GetThreadSlot()
+	{
+		if (!t_slot)
+		{
+			uint32_t index = s_slot_count.fetch_add(1, std::memory_order_relaxed);
+			t_slot = index < PERF_MAX_THREADS ? &s_slots[index] : &s_shared_slot;
+		}
+
+		return *t_slot;
+	}
+}
+
+void PerfCounters::AddToThread(PerfCounter counter, uint64_t value)
+{
+	if (t_suppressed > 0)
+		return;
+
+	PerfSlot& slot = GetThreadSlot();
+	std::atomic<uint64_t>& target = slot.values[static_cast<size_t>(counter)];
+
+	// Only this thread writes its slot, a load + store is enough for readers to see whole values
+	if (&slot == &s_shared_slot)
+		target.fetch_add(value, std::memory_order_relaxed);
+	else
+		target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void PerfCounters::Read(PerfTotals& totals)
+{
+	totals = PerfTotals();
+
+	uint32_t slot_count = s_slot_count.load(std::memory_order_relaxed);
+	if (slot_count > PERF_MAX_THREADS)
+		slot_count = PERF_MAX_THREADS;
+
+	for (size_t counter = 0; counter < COUNTER_COUNT; ++counter)
+	{
+		uint64_t sum = s_shared_slot.values[counter].load(std::memory_order_relaxed);
+		for (uint32_t slot = 0; slot < slot_count; ++slot)
+		{
+			sum += s_slots[slot].values[counter].load(std::memory_order_relaxed);
+		}
+		totals.values[counter] = sum;
+	}
+}
+
+PerfCounters::Suppress::Suppress()
+{
+	++t_suppressed;
+}
+
+PerfCounters::Suppress::~Suppress()
+{
+	--t_suppressed;
+}
+
+// Allocation counting. Only the plain forms are replaced, the array and nothrow defaults forward
+// to them, over-aligned allocations keep the library versions and are not counted
+void* operator new(std::size_t size)
+{
+	if (PerfCounters::IsEnabled())
+	{
+		PerfCounters::Add(PerfCounter::Allocations, 1);
+		PerfCounters::Add(PerfCounter::AllocatedBytes, size);
+	}
+
+	if (size == 0)
+		size = 1;
+
+	for (;;)
+	{
+		if (void* memory = std::malloc(size))
+			return memory;
+
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+
+		handler();
+	}
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+// C++14 sized deallocation would otherwise reach the library's delete, which is not paired with our malloc
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
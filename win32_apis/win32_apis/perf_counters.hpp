@@ -0,0 +1,99 @@
+﻿#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+
+// Threads with a private accumulator, later threads share one
+#define PERF_MAX_THREADS 64
+
+enum class PerfCounter : uint8_t
+{
+	// Stage times in nanoseconds, see PerfScope
+	UpdateTime,
+	ProjectTime,
+	RenderTime,
+	RasterTime,
+	PresentTime,
+
+	PixelsFilled,		// Clears, spans and mask blits, single pixels and lines are not counted
+	PrimitivesDrawn,
+	PrimitivesCulled,	// Rejected before rasterization (off screen or clipped away)
+	ChunksCulled,		// Entity chunks skipped by a view's culling
+	Allocations,		// Global operator new calls
+	AllocatedBytes,
+
+	Count
+};
+
+// Counters summed over every thread since the counters were enabled
+struct PerfTotals
+{
+	uint64_t values[static_cast<size_t>(PerfCounter::Count)] = {};
+
+	uint64_t operator[](PerfCounter counter) const { return values[static_cast<size_t>(counter)]; }
+};
+
+// Each thread adds into its own cache line aligned slot with plain relaxed stores, no lock and no
+// contended atomic, so counting stays cheap inside kernels and worker jobs. Readers sum all slots.
+// Disabled (the default) every Add is one relaxed load and a branch
+class PerfCounters
+{
+public:
+	static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+	static void SetEnabled(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+
+	static void Add(PerfCounter counter, uint64_t value)
+	{
+		if (IsEnabled())
+			AddToThread(counter, value);
+	}
+
+	// Sums every slot, values only grow. Diff two reads for per frame numbers
+	static void Read(PerfTotals& totals);
+
+	// Counting on the calling thread is skipped while at least one of these is alive.
+	// The HUD uses it so drawing itself never shows up in what it reports
+	class Suppress
+	{
+	public:
+		Suppress();
+		~Suppress();
+
+		Suppress(const Suppress&) = delete;
+		Suppress& operator=(const Suppress&) = delete;
+	};
+
+private:
+	static void AddToThread(PerfCounter counter, uint64_t value);
+
+	static std::atomic<bool> s_enabled;
+};
+
+// Adds the scope's wall time to a stage counter, the clock is only read while counting is enabled
+class PerfScope
+{
+public:
+	explicit PerfScope(PerfCounter counter) : m_counter(counter), m_active(PerfCounters::IsEnabled())
+	{
+		if (m_active)
+			m_start = std::chrono::steady_clock::now();
+	}
+
+	~PerfScope()
+	{
+		if (m_active)
+		{
+			std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - m_start;
+			PerfCounters::Add(m_counter, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+		}
+	}
+
+	PerfScope(const PerfScope&) = delete;
+	PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+	PerfCounter m_counter;
+	bool m_active;
+	std::chrono::steady_clock::time_point m_start;
+};
@@ -0,0 +1,135 @@
+﻿#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "perf_hud.hpp"
+
+#define HUD_MARGIN 8
+#define HUD_PADDING 6
+#define HUD_GRAPH_HEIGHT 40
+#define HUD_TARGET_MS (1000.0f / 60.0f)
+
+namespace
+{
+	double ToMs(uint64_t nanoseconds)
+	{
+		return nanoseconds / 1000000.0;
+	}
+
+	// Bar color by how far a frame missed 60 FPS
+	uint32_t FrameTimeColor(float ms)
+	{
+		if (ms <= HUD_TARGET_MS)
+			return 0xFF57A649;
+		if (ms <= HUD_TARGET_MS * 2.0f)
+			return 0xFFE0B030;
+		return 0xFFD04040;
+	}
+}
+
+void PerfHud::Sample()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	PerfTotals totals;
+	PerfCounters::Read(totals);
+
+	if (m_has_last)
+	{
+		for (size_t i = 0; i < static_cast<size_t>(PerfCounter::Count); ++i)
+		{
+			m_frame.values[i] = totals.values[i] - m_last.values[i];
+		}
+
+		m_frame_ms[m_history_next] = std::chrono::duration<float, std::milli>(now - m_last_time).count();
+		m_history_next = (m_history_next + 1) % PERF_HUD_HISTORY;
+		m_history_count = std::min(m_history_count + 1, PERF_HUD_HISTORY);
+	}
+
+	m_last = totals;
+	m_last_time = now;
+	m_has_last = true;
+}
+
+void PerfHud::DrawOverlay(const OverlayView& target)
+{
+	// Everything below (blits, string formatting, cache inserts) stays out of the numbers
+	PerfCounters::Suppress suppress;
+
+	Sample();
+
+	if (!m_text_ready)
+	{
+		m_text_ready = m_text.Initialize(14);
+		m_text.SetCacheLimit(256);
+		if (!m_text_ready)
+			return;
+	}
+
+	float average_ms = 0.0f, max_ms = 0.0f;
+	for (int i = 0; i < m_history_count; ++i)
+	{
+		average_ms += m_frame_ms[i];
+		max_ms = std::max(max_ms, m_frame_ms[i]);
+	}
+	average_ms = m_history_count > 0 ? average_ms / m_history_count : 0.0f;
+
+	char lines[5][96];
+	std::snprintf(lines[0], sizeof(lines[0]), "FPS %.1f  %.2f ms (max %.2f)",
+		average_ms > 0.0f ? 1000.0f / average_ms : 0.0f, average_ms, max_ms);
+	std::snprintf(lines[1], sizeof(lines[1]), "update %.2f  project %.2f ms",
+		ToMs(m_frame[PerfCounter::UpdateTime]), ToMs(m_frame[PerfCounter::ProjectTime]));
+	std::snprintf(lines[2], sizeof(lines[2]), "render %.2f  raster %.2f  present %.2f ms",
+		ToMs(m_frame[PerfCounter::RenderTime]), ToMs(m_frame[PerfCounter::RasterTime]), ToMs(m_frame[PerfCounter::PresentTime]));
+	std::snprintf(lines[3], sizeof(lines[3]), "pixels %.2fM  prims %llu  culled %llu",
+		m_frame[PerfCounter::PixelsFilled] / 1000000.0,
+		static_cast<unsigned long long>(m_frame[PerfCounter::PrimitivesDrawn]),
+		static_cast<unsigned long long>(m_frame[PerfCounter::PrimitivesCulled]));
+	std::snprintf(lines[4], sizeof(lines[4]), "chunks culled %llu  allocs %llu (%.1f KB)",
+		static_cast<unsigned long long>(m_frame[PerfCounter::ChunksCulled]),
+		static_cast<unsigned long long>(m_frame[PerfCounter::Allocations]),
+		m_frame[PerfCounter::AllocatedBytes] / 1024.0);
+
+	const int line_height = m_text.GetLineHeight();
+	int text_width = PERF_HUD_HISTORY * 2;
+	for (const char* line : lines)
+	{
+		text_width = std::max(text_width, m_text.Shape(line).width);
+	}
+
+	const int panel_width = text_width + 2 * HUD_PADDING;
+	const int panel_height = 5 * line_height + HUD_GRAPH_HEIGHT + 2 * HUD_PADDING;
+	FillRectKernel<BlendMode::Alpha, ClipMode::Clip>(target, HUD_MARGIN, HUD_MARGIN, panel_width, panel_height, 0xB0101010);
+
+	int y = HUD_MARGIN + HUD_PADDING;
+	for (const char* line : lines)
+	{
+		m_text.DrawString(target, HUD_MARGIN + HUD_PADDING, y, line, 0xFFE0E0E0);
+		y += line_height;
+	}
+
+	DrawGraph(target, HUD_MARGIN + HUD_PADDING, y, PERF_HUD_HISTORY * 2, HUD_GRAPH_HEIGHT);
+}
+
+void PerfHud::DrawGraph(const OverlayView& target, int x, int y, int width, int height) const
+{
+	// Full height is two 60 FPS frames, the line marks one
+	const float scale = height / (HUD_TARGET_MS * 2.0f);
+	const int bar_width = width / PERF_HUD_HISTORY;
+
+	FillRectKernel<BlendMode::Alpha, ClipMode::Clip>(target, x, y, width, height, 0x40FFFFFF);
+
+	// Oldest on the left, newest on the right
+	const int first = (m_history_next - m_history_count + PERF_HUD_HISTORY) % PERF_HUD_HISTORY;
+	const int offset = PERF_HUD_HISTORY - m_history_count;
+
+	for (int i = 0; i < m_history_count; ++i)
+	{
+		const float ms = m_frame_ms[(first + i) % PERF_HUD_HISTORY];
+		const int bar_height = std::min(std::max(static_cast<int>(ms * scale), 1), height);
+
+		FillRectKernel<BlendMode::Opaque, ClipMode::Clip>(target, x + (offset + i) * bar_width, y + height - bar_height, bar_width, bar_height, FrameTimeColor(ms));
+	}
+
+	FillSpanKernel<BlendMode::Alpha, ClipMode::Clip>(target, x, y + height - static_cast<int>(HUD_TARGET_MS * scale), width, 0x80FFFFFF);
+}
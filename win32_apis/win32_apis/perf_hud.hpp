@@ -0,0 +1,37 @@
+﻿#pragma once
+#include <stdint.h>
+#include <chrono>
+
+#include "irender_overlay.hpp"
+#include "perf_counters.hpp"
+#include "text_renderer.hpp"
+
+// Frames kept for the frame time graph
+#define PERF_HUD_HISTORY 120
+
+// Overlay with FPS, a frame time graph, stage timings and per frame counters. Numbers are the
+// PerfCounters delta between two presents, the HUD's own drawing is not counted
+class PerfHud : public IRenderOverlay
+{
+public:
+	PerfHud() = default;
+
+	void DrawOverlay(const OverlayView& target) override;
+
+private:
+	void Sample();
+	void DrawGraph(const OverlayView& target, int x, int y, int width, int height) const;
+
+private:
+	TextRenderer m_text;
+	bool m_text_ready = false;
+
+	PerfTotals m_last;
+	PerfTotals m_frame;		// Last frame's share of every counter
+	std::chrono::steady_clock::time_point m_last_time;
+	bool m_has_last = false;
+
+	float m_frame_ms[PERF_HUD_HISTORY] = {};
+	int m_history_next = 0;
+	int m_history_count = 0;
+};
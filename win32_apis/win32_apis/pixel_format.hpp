@@ -0,0 +1,141 @@
+﻿#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// Tile edge in pixels for FramebufferLayout::Tiled (must be a power of two)
+#define FRAMEBUFFER_TILE_SHIFT 3
+#define FRAMEBUFFER_TILE_SIZE (1 << FRAMEBUFFER_TILE_SHIFT)
+
+enum class PixelFormat : uint8_t
+{
+	ARGB8888,	// 32 bits, 0xAARRGGBB
+	RGB565,		// 16 bits, no alpha
+	Indexed8	// 8 bits, fixed 3-3-2 palette
+};
+
+enum class FramebufferLayout : uint8_t
+{
+	Linear,		// Row major
+	Tiled		// FRAMEBUFFER_TILE_SIZE^2 blocks, converted to linear at present
+};
+
+// ---------------------------------------------------------------------------
+// Pixel formats
+// Encode converts 0xAARRGGBB to the stored pixel, Decode goes back (alpha = 0xFF)
+// ---------------------------------------------------------------------------
+struct PixelARGB8888
+{
+	typedef uint32_t pixel_t;
+	static const PixelFormat format = PixelFormat::ARGB8888;
+
+	static pixel_t Encode(uint32_t color) { return color; }
+	static uint32_t Decode(pixel_t pixel) { return pixel; }
+};
+
+struct PixelRGB565
+{
+	typedef uint16_t pixel_t;
+	static const PixelFormat format = PixelFormat::RGB565;
+
+	static pixel_t Encode(uint32_t color)
+	{
+		return static_cast<pixel_t>(
+			((color >> 8) & 0xF800) |	// R: bits 23..19 -> 15..11
+			((color >> 5) & 0x07E0) |	// G: bits 15..10 -> 10..5
+			((color >> 3) & 0x001F));	// B: bits 7..3   -> 4..0
+	}
+
+	static uint32_t Decode(pixel_t pixel)
+	{
+		uint32_t r = (pixel >> 11) & 0x1F;
+		uint32_t g = (pixel >> 5) & 0x3F;
+		uint32_t b = pixel & 0x1F;
+
+		// Replicate the high bits so 0x1F maps to 0xFF
+		r = (r << 3) | (r >> 2);
+		g = (g << 2) | (g >> 4);
+		b = (b << 3) | (b >> 2);
+
+		return 0xFF000000 | (r << 16) | (g << 8) | b;
+	}
+};
+
+struct PixelIndexed8
+{
+	typedef uint8_t pixel_t;
+	static const PixelFormat format = PixelFormat::Indexed8;
+
+	// Palette index is RRRGGGBB, so encoding needs no palette search
+	static pixel_t Encode(uint32_t color)
+	{
+		return static_cast<pixel_t>(
+			((color >> 16) & 0xE0) |
+			((color >> 11) & 0x1C) |
+			((color >> 6) & 0x03));
+	}
+
+	static uint32_t Decode(pixel_t pixel)
+	{
+		uint32_t r = (pixel >> 5) & 0x7;
+		uint32_t g = (pixel >> 2) & 0x7;
+		uint32_t b = pixel & 0x3;
+
+		r = (r << 5) | (r << 2) | (r >> 1);
+		g = (g << 5) | (g << 2) | (g >> 1);
+		b = b * 0x55;
+
+		return 0xFF000000 | (r << 16) | (g << 8) | b;
+	}
+};
+
+// ---------------------------------------------------------------------------
+// Framebuffer layouts
+// ---------------------------------------------------------------------------
+struct LinearLayout
+{
+	static const FramebufferLayout layout = FramebufferLayout::Linear;
+
+	static size_t Index(int x, int y, int width, int /*tiles_x*/)
+	{
+		return static_cast<size_t>(y) * width + x;
+	}
+};
+
+struct TiledLayout
+{
+	static const FramebufferLayout layout = FramebufferLayout::Tiled;
+
+	static size_t Index(int x, int y, int /*width*/, int tiles_x)
+	{
+		const int mask = FRAMEBUFFER_TILE_SIZE - 1;
+		size_t tile = static_cast<size_t>(y >> FRAMEBUFFER_TILE_SHIFT) * tiles_x + (x >> FRAMEBUFFER_TILE_SHIFT);
+
+		return (tile << (2 * FRAMEBUFFER_TILE_SHIFT)) + ((y & mask) << FRAMEBUFFER_TILE_SHIFT) + (x & mask);
+	}
+};
+
+// Typed window over the back buffer handed to the drawing kernels
+template<typename Format, typename Layout>
+struct FramebufferView
+{
+	typedef Format format_t;
+	typedef Layout layout_t;
+	typedef typename Format::pixel_t pixel_t;
+
+	pixel_t* pixels;
+	int width;
+	int height;
+	int tiles_x;
+
+	pixel_t* At(int x, int y) const { return pixels + Layout::Index(x, y, width, tiles_x); }
+};
+
+inline size_t GetPixelSize(PixelFormat format)
+{
+	switch (format)
+	{
+	case PixelFormat::RGB565:	return sizeof(PixelRGB565::pixel_t);
+	case PixelFormat::Indexed8:	return sizeof(PixelIndexed8::pixel_t);
+	default:					return sizeof(PixelARGB8888::pixel_t);
+	}
+}
@@ -9,5 +9,7 @@ IPlatformAdapter* GetPlatformAdapter()
 {
 #ifdef _WIN32
 	return new WindowsAdapter();
+#else
+	return nullptr;
 #endif
 }
\ No newline at end of file
@@ -0,0 +1,544 @@
+﻿#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "point_cloud.hpp"
+#include "entropy_coder.hpp"
+#include "perf_counters.hpp"
+
+// Grid cells per axis for the Morton order (10 bits each, 30 bit codes)
+#define MORTON_CELLS 1024
+
+// Longest varint of a zigzag coded uint16 delta (17 bits, 7 per byte)
+#define DELTA_MAX_VARINT_BYTES 3
+
+namespace
+{
+	struct PointCloudFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t encoding;
+		uint32_t point_count;
+		uint32_t chunk_count;
+	};
+
+	// Followed by three axis streams (x, y, z), each a uint32 byte count and the encoded coordinates
+	struct PointCloudFileChunk
+	{
+		float origin[3];
+		float step[3];
+	};
+
+	// Multiply, then add, like the projection kernels
+	inline float Dequantize(uint16_t q, float step, float origin)
+	{
+		return static_cast<float>(q) * step + origin;
+	}
+
+	inline uint16_t Quantize(float value, float origin, float step)
+	{
+		if (step <= 0.0f)
+			return 0;
+
+		const float scaled = (value - origin) / step + 0.5f;
+		return static_cast<uint16_t>(scaled <= 0.0f ? 0.0f : std::min(scaled, 65535.0f));
+	}
+
+	// 10 bit value spread to every third bit
+	inline uint32_t SpreadBits(uint32_t value)
+	{
+		value &= 0x3FF;
+		value = (value | (value << 16)) & 0x030000FF;
+		value = (value | (value << 8)) & 0x0300F00F;
+		value = (value | (value << 4)) & 0x030C30C3;
+		value = (value | (value << 2)) & 0x09249249;
+		return value;
+	}
+
+	inline uint32_t ToCell(float value, float low, float cell_scale)
+	{
+		const float cell = (value - low) * cell_scale;
+		return static_cast<uint32_t>(cell <= 0.0f ? 0.0f : std::min(cell, static_cast<float>(MORTON_CELLS - 1)));
+	}
+
+	void WriteVarint(uint32_t value, std::vector<uint8_t>& out)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	bool ReadVarint(const uint8_t*& data, const uint8_t* end, uint32_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 32; shift += 7)
+		{
+			if (data == end)
+				return false;
+
+			const uint8_t byte = *data++;
+			value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	// Deltas restart at every chunk, so a chunk never depends on the one before it
+	void EncodeDeltas(const std::vector<uint16_t>& values, std::vector<uint8_t>& out)
+	{
+		for (size_t first = 0; first < values.size(); first += POINT_CLOUD_CHUNK_SIZE)
+		{
+			const size_t last = std::min(first + POINT_CLOUD_CHUNK_SIZE, values.size());
+
+			int32_t previous = 0;
+			for (size_t i = first; i < last; ++i)
+			{
+				const int32_t delta = static_cast<int32_t>(values[i]) - previous;
+				WriteVarint((static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31), out);
+				previous = values[i];
+			}
+		}
+	}
+
+	bool DecodeDeltas(const uint8_t* data, size_t size, std::vector<uint16_t>& values)
+	{
+		const uint8_t* end = data + size;
+
+		for (size_t first = 0; first < values.size(); first += POINT_CLOUD_CHUNK_SIZE)
+		{
+			const size_t last = std::min(first + POINT_CLOUD_CHUNK_SIZE, values.size());
+
+			int32_t previous = 0;
+			for (size_t i = first; i < last; ++i)
+			{
+				uint32_t zigzag;
+				if (!ReadVarint(data, end, zigzag))
+					return false;
+
+				const int32_t value = previous + (static_cast<int32_t>(zigzag >> 1) ^ -static_cast<int32_t>(zigzag & 1));
+				if (value < 0 || value > 0xFFFF)
+					return false;
+
+				values[i] = static_cast<uint16_t>(value);
+				previous = value;
+			}
+		}
+
+		return data == end;
+	}
+
+	void EncodeAxis(const std::vector<uint16_t>& values, PointCloudEncoding encoding, std::vector<uint8_t>& out)
+	{
+		out.clear();
+
+		if (encoding == PointCloudEncoding::Raw)
+		{
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values.data());
+			out.assign(bytes, bytes + values.size() * sizeof(uint16_t));
+			return;
+		}
+
+		if (encoding == PointCloudEncoding::Delta)
+		{
+			EncodeDeltas(values, out);
+			return;
+		}
+
+		std::vector<uint8_t> deltas;
+		EncodeDeltas(values, deltas);
+		RansEncode(deltas.data(), deltas.size(), out);
+	}
+
+	bool DecodeAxis(const uint8_t* data, size_t size, PointCloudEncoding encoding, std::vector<uint16_t>& values)
+	{
+		if (encoding == PointCloudEncoding::Raw)
+		{
+			if (size != values.size() * sizeof(uint16_t))
+				return false;
+
+			std::memcpy(values.data(), data, size);
+			return true;
+		}
+
+		if (encoding == PointCloudEncoding::Delta)
+			return DecodeDeltas(data, size, values);
+
+		// The point count bounds the delta stream, a corrupt size cannot make the decoder allocate more
+		std::vector<uint8_t> deltas;
+		return RansDecode(data, size, values.size() * DELTA_MAX_VARINT_BYTES, deltas) && DecodeDeltas(deltas.data(), deltas.size(), values);
+	}
+}
+
+const char* GetPointCloudEncodingName(PointCloudEncoding encoding)
+{
+	switch (encoding)
+	{
+	case PointCloudEncoding::Raw:		return "raw";
+	case PointCloudEncoding::Delta:		return "delta";
+	case PointCloudEncoding::Entropy:	return "entropy";
+	}
+	return "unknown";
+}
+
+bool ParsePointCloudEncoding(const char* name, PointCloudEncoding& encoding)
+{
+	for (PointCloudEncoding candidate : { PointCloudEncoding::Raw, PointCloudEncoding::Delta, PointCloudEncoding::Entropy })
+	{
+		if (std::strcmp(name, GetPointCloudEncodingName(candidate)) == 0)
+		{
+			encoding = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+void PointCloud::Build(const float* xs, const float* ys, const float* zs, size_t count)
+{
+	Clear();
+	if (count == 0)
+		return;
+
+	vec3_t low(xs[0], ys[0], zs[0]);
+	vec3_t high = low;
+	for (size_t i = 1; i < count; ++i)
+	{
+		low.x = std::min(low.x, xs[i]);
+		low.y = std::min(low.y, ys[i]);
+		low.z = std::min(low.z, zs[i]);
+		high.x = std::max(high.x, xs[i]);
+		high.y = std::max(high.y, ys[i]);
+		high.z = std::max(high.z, zs[i]);
+	}
+
+	const float cells = static_cast<float>(MORTON_CELLS);
+	const vec3_t cell_scale(
+		high.x > low.x ? cells / (high.x - low.x) : 0.0f,
+		high.y > low.y ? cells / (high.y - low.y) : 0.0f,
+		high.z > low.z ? cells / (high.z - low.z) : 0.0f);
+
+	// Morton code in the high half, point index in the low half: one sort, deterministic ties
+	std::vector<uint64_t> order(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint32_t code = SpreadBits(ToCell(xs[i], low.x, cell_scale.x)) |
+			(SpreadBits(ToCell(ys[i], low.y, cell_scale.y)) << 1) |
+			(SpreadBits(ToCell(zs[i], low.z, cell_scale.z)) << 2);
+		order[i] = (static_cast<uint64_t>(code) << 32) | i;
+	}
+	std::sort(order.begin(), order.end());
+
+	m_x.resize(count);
+	m_y.resize(count);
+	m_z.resize(count);
+	m_chunks.resize((count + POINT_CLOUD_CHUNK_SIZE - 1) / POINT_CLOUD_CHUNK_SIZE);
+
+	for (size_t chunk = 0; chunk < m_chunks.size(); ++chunk)
+	{
+		const size_t first = chunk * POINT_CLOUD_CHUNK_SIZE;
+		const size_t last = std::min(first + POINT_CLOUD_CHUNK_SIZE, count);
+
+		const uint32_t head = static_cast<uint32_t>(order[first]);
+		vec3_t box_min(xs[head], ys[head], zs[head]);
+		vec3_t box_max = box_min;
+		for (size_t i = first + 1; i < last; ++i)
+		{
+			const uint32_t index = static_cast<uint32_t>(order[i]);
+			box_min.x = std::min(box_min.x, xs[index]);
+			box_min.y = std::min(box_min.y, ys[index]);
+			box_min.z = std::min(box_min.z, zs[index]);
+			box_max.x = std::max(box_max.x, xs[index]);
+			box_max.y = std::max(box_max.y, ys[index]);
+			box_max.z = std::max(box_max.z, zs[index]);
+		}
+
+		// Error per axis is at most half a step, (max - min) / 131070
+		Chunk& state = m_chunks[chunk];
+		state.origin = box_min;
+		state.step = vec3_t((box_max.x - box_min.x) / 65535.0f, (box_max.y - box_min.y) / 65535.0f, (box_max.z - box_min.z) / 65535.0f);
+
+		for (size_t i = first; i < last; ++i)
+		{
+			const uint32_t index = static_cast<uint32_t>(order[i]);
+			m_x[i] = Quantize(xs[index], state.origin.x, state.step.x);
+			m_y[i] = Quantize(ys[index], state.origin.y, state.step.y);
+			m_z[i] = Quantize(zs[index], state.origin.z, state.step.z);
+		}
+
+		FinishChunk(chunk);
+	}
+}
+
+void PointCloud::Clear()
+{
+	m_x.clear();
+	m_y.clear();
+	m_z.clear();
+	m_chunks.clear();
+}
+
+size_t PointCloud::GetMemoryBytes() const
+{
+	return (m_x.size() + m_y.size() + m_z.size()) * sizeof(uint16_t) + m_chunks.size() * sizeof(Chunk);
+}
+
+vec3_t PointCloud::GetPosition(size_t index) const
+{
+	const Chunk& chunk = m_chunks[index / POINT_CLOUD_CHUNK_SIZE];
+	return vec3_t(
+		Dequantize(m_x[index], chunk.step.x, chunk.origin.x),
+		Dequantize(m_y[index], chunk.step.y, chunk.origin.y),
+		Dequantize(m_z[index], chunk.step.z, chunk.origin.z));
+}
+
+void PointCloud::FinishChunk(size_t chunk)
+{
+	const size_t first = chunk * POINT_CLOUD_CHUNK_SIZE;
+	const size_t last = std::min(first + POINT_CLOUD_CHUNK_SIZE, GetCount());
+
+	// Culling bounds from dequantized values, the points projection actually sees
+	vec3_t box_min = GetPosition(first);
+	vec3_t box_max = box_min;
+	for (size_t i = first + 1; i < last; ++i)
+	{
+		const vec3_t position = GetPosition(i);
+		box_min.x = std::min(box_min.x, position.x);
+		box_min.y = std::min(box_min.y, position.y);
+		box_min.z = std::min(box_min.z, position.z);
+		box_max.x = std::max(box_max.x, position.x);
+		box_max.y = std::max(box_max.y, position.y);
+		box_max.z = std::max(box_max.z, position.z);
+	}
+
+	Chunk& state = m_chunks[chunk];
+	state.bounds_min = box_min;
+	state.bounds_max = box_max;
+	state.version = EntityStore::NextVersion();
+}
+
+void PointCloud::ProjectViews(JobSystem& jobs, RenderView* views, size_t view_count, float margin) const
+{
+	PerfScope scope(PerfCounter::ProjectTime);
+
+	const size_t count = GetCount();
+	const size_t chunk_count = m_chunks.size();
+
+	m_stale_view_chunks.clear();
+	for (size_t v = 0; v < view_count; ++v)
+	{
+		RenderView& view = views[v];
+		Projection& projection = view.projection;
+
+		projection.SetFOVFactors(view.camera.fov_factor);
+		projection.BeginCachedFrame(view.camera.position, count, chunk_count);
+
+		bool visibility_changed = view.visible_chunks.size() != chunk_count;
+		view.visible_chunks.resize(chunk_count, 0);
+
+		size_t culled = 0;
+		for (size_t chunk = 0; chunk < chunk_count; ++chunk)
+		{
+			const Chunk& state = m_chunks[chunk];
+			uint8_t visible = IsBoxInView(state.bounds_min, state.bounds_max, view.camera, view.viewport, margin) ? 1 : 0;
+
+			visibility_changed |= visible != view.visible_chunks[chunk];
+			view.visible_chunks[chunk] = visible;
+			culled += visible ? 0 : 1;
+		}
+		PerfCounters::Add(PerfCounter::ChunksCulled, culled);
+
+		if (visibility_changed)
+			projection.InvalidateCache();
+
+		for (size_t chunk = 0; chunk < chunk_count; ++chunk)
+		{
+			if (view.visible_chunks[chunk] && !projection.IsChunkCached(chunk, m_chunks[chunk].version))
+				m_stale_view_chunks.push_back({ static_cast<uint32_t>(v), static_cast<uint32_t>(chunk) });
+		}
+	}
+
+	if (FrameCapture* capture = FrameCapture::GetActive())
+	{
+		size_t pair = 0;
+		for (size_t v = 0; v < view_count; ++v)
+		{
+			m_capture_chunks.clear();
+			for (; pair < m_stale_view_chunks.size() && m_stale_view_chunks[pair].view == v; ++pair)
+				m_capture_chunks.push_back(m_stale_view_chunks[pair].chunk);
+
+			CaptureProjection(*capture, static_cast<uint32_t>(v), views[v].camera, m_capture_chunks.data(), m_capture_chunks.size());
+		}
+	}
+
+	if (m_stale_view_chunks.empty())
+		return;
+
+	const ViewChunk* stale = m_stale_view_chunks.data();
+
+	jobs.ParallelFor(m_stale_view_chunks.size(), 1, [this, views, stale, count](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			RenderView& view = views[stale[i].view];
+			vec2_t* out = view.projection.GetProjectedPoints().data();
+
+			const Chunk& chunk = m_chunks[stale[i].chunk];
+			size_t first = static_cast<size_t>(stale[i].chunk) * POINT_CLOUD_CHUNK_SIZE;
+			size_t last = std::min(first + POINT_CLOUD_CHUNK_SIZE, count);
+
+			view.projection.ProjectQuantizedRange(m_x.data() + first, m_y.data() + first, m_z.data() + first,
+				last - first, chunk.origin, chunk.step, view.camera.position, out + first);
+		}
+	});
+
+	for (const ViewChunk& pair : m_stale_view_chunks)
+	{
+		views[pair.view].projection.MarkChunkCached(pair.chunk, m_chunks[pair.chunk].version);
+	}
+}
+
+void PointCloud::CaptureProjection(FrameCapture& capture, uint32_t view, const Camera& camera, const uint32_t* chunks, size_t chunk_count) const
+{
+	const size_t count = GetCount();
+
+	for (size_t i = 0; i < chunk_count; ++i)
+	{
+		const size_t chunk = chunks[i];
+		if (!capture.NeedsPositions(chunk, m_chunks[chunk].version))
+			continue;
+
+		const size_t first = chunk * POINT_CLOUD_CHUNK_SIZE;
+		const size_t length = std::min(first + POINT_CLOUD_CHUNK_SIZE, count) - first;
+
+		capture.Record(CaptureRecord::QuantizedPositions, static_cast<uint32_t>(first), m_chunks[chunk].origin, m_chunks[chunk].step,
+			MakeCaptureSpan(m_x.data() + first, length), MakeCaptureSpan(m_y.data() + first, length), MakeCaptureSpan(m_z.data() + first, length));
+	}
+
+	capture.Record(CaptureRecord::Project, view, camera.position, camera.fov_factor, static_cast<uint32_t>(count),
+		MakeCaptureSpan(chunks, chunk_count));
+}
+
+bool PointCloud::Save(const std::string& path, PointCloudEncoding encoding) const
+{
+	std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		std::cerr << "Point cloud: failed to open " << path << "\n";
+		return false;
+	}
+
+	PointCloudFileHeader header = {};
+	header.magic = POINT_CLOUD_MAGIC;
+	header.version = POINT_CLOUD_VERSION;
+	header.encoding = static_cast<uint32_t>(encoding);
+	header.point_count = static_cast<uint32_t>(GetCount());
+	header.chunk_count = static_cast<uint32_t>(m_chunks.size());
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	for (const Chunk& chunk : m_chunks)
+	{
+		PointCloudFileChunk record = { { chunk.origin.x, chunk.origin.y, chunk.origin.z }, { chunk.step.x, chunk.step.y, chunk.step.z } };
+		stream.write(reinterpret_cast<const char*>(&record), sizeof(record));
+	}
+
+	std::vector<uint8_t> bytes;
+	for (const std::vector<uint16_t>* axis : { &m_x, &m_y, &m_z })
+	{
+		EncodeAxis(*axis, encoding, bytes);
+
+		const uint32_t size = static_cast<uint32_t>(bytes.size());
+		stream.write(reinterpret_cast<const char*>(&size), sizeof(size));
+		stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	}
+
+	if (!stream)
+	{
+		std::cerr << "Point cloud: failed to write " << path << "\n";
+		return false;
+	}
+
+	return true;
+}
+
+bool PointCloud::Load(const std::string& path)
+{
+	Clear();
+
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream)
+	{
+		std::cerr << "Point cloud: failed to open " << path << "\n";
+		return false;
+	}
+
+	PointCloudFileHeader header;
+	if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+		header.magic != POINT_CLOUD_MAGIC || header.version != POINT_CLOUD_VERSION ||
+		header.encoding > static_cast<uint32_t>(PointCloudEncoding::Entropy) ||
+		header.chunk_count != (static_cast<uint64_t>(header.point_count) + POINT_CLOUD_CHUNK_SIZE - 1) / POINT_CLOUD_CHUNK_SIZE)
+	{
+		std::cerr << "Point cloud: " << path << " is not a point cloud this build can read\n";
+		return false;
+	}
+
+	const std::vector<uint8_t> data((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	const uint8_t* cursor = data.data();
+	const uint8_t* end = cursor + data.size();
+	const PointCloudEncoding encoding = static_cast<PointCloudEncoding>(header.encoding);
+
+	bool valid = static_cast<size_t>(end - cursor) >= header.chunk_count * sizeof(PointCloudFileChunk);
+	if (valid)
+	{
+		m_chunks.resize(header.chunk_count);
+		for (Chunk& chunk : m_chunks)
+		{
+			PointCloudFileChunk record;
+			std::memcpy(&record, cursor, sizeof(record));
+			cursor += sizeof(record);
+
+			chunk.origin = vec3_t(record.origin[0], record.origin[1], record.origin[2]);
+			chunk.step = vec3_t(record.step[0], record.step[1], record.step[2]);
+		}
+
+		m_x.resize(header.point_count);
+		m_y.resize(header.point_count);
+		m_z.resize(header.point_count);
+	}
+
+	for (std::vector<uint16_t>* axis : { &m_x, &m_y, &m_z })
+	{
+		uint32_t size;
+		if (!valid || end - cursor < static_cast<ptrdiff_t>(sizeof(size)))
+		{
+			valid = false;
+			break;
+		}
+
+		std::memcpy(&size, cursor, sizeof(size));
+		cursor += sizeof(size);
+
+		valid = size <= static_cast<size_t>(end - cursor) && DecodeAxis(cursor, size, encoding, *axis);
+		cursor += valid ? size : 0;
+	}
+
+	if (!valid || cursor != end)
+	{
+		std::cerr << "Point cloud: " << path << " is truncated or corrupt\n";
+		Clear();
+		return false;
+	}
+
+	for (size_t chunk = 0; chunk < m_chunks.size(); ++chunk)
+	{
+		FinishChunk(chunk);
+	}
+
+	return true;
+}
@@ -0,0 +1,94 @@
+﻿#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "vector.h"
+#include "job_system.hpp"
+#include "projection.hpp"
+#include "render_view.hpp"
+#include "frame_capture.hpp"
+#include "entity_store.hpp"
+
+// Same chunking as EntityStore, so RenderView::visible_chunks and draw loops index both alike
+#define POINT_CLOUD_CHUNK_SIZE ENTITY_CHUNK_SIZE
+
+#define POINT_CLOUD_MAGIC 0x444C4350	// "PCLD"
+#define POINT_CLOUD_VERSION 1
+
+// How Save writes the quantized coordinates, chunk origins and steps are always raw floats
+enum class PointCloudEncoding : uint8_t
+{
+	Raw,		// uint16 per coordinate
+	Delta,		// Difference to the previous point of the chunk, zigzag LEB128 varints
+	Entropy		// Delta, then each axis stream rANS coded (see entropy_coder.hpp)
+};
+
+const char* GetPointCloudEncodingName(PointCloudEncoding encoding);
+bool ParsePointCloudEncoding(const char* name, PointCloudEncoding& encoding);
+
+// Static points quantized to 16 bits per axis: each chunk keeps an origin and a step per axis,
+// each point three uint16 (6 bytes instead of 12). Build orders points along a Morton curve, so a chunk
+// covers a compact box: small steps, tight culling bounds and small deltas on disk.
+// Projection dequantizes inside the kernels (CpuKernels::project_quantized)
+class PointCloud
+{
+public:
+	PointCloud() = default;
+
+public:
+	// Quantizes count points, replacing the cloud. Point order is not kept
+	void Build(const float* xs, const float* ys, const float* zs, size_t count);
+	void Clear();
+
+	size_t GetCount() const { return m_x.size(); }
+	size_t GetChunkCount() const { return m_chunks.size(); }
+
+	// Resident bytes of positions and chunk headers
+	size_t GetMemoryBytes() const;
+
+	// Dequantized, exactly what projection sees
+	vec3_t GetPosition(size_t index) const;
+
+	uint64_t GetChunkVersion(size_t chunk) const { return m_chunks[chunk].version; }
+
+public:
+	// Same contract as EntityStore::ProjectViews: per view culling against chunk bounds, only stale chunks reprojected
+	void ProjectViews(JobSystem& jobs, RenderView* views, size_t view_count, float margin) const;
+
+	bool Save(const std::string& path, PointCloudEncoding encoding) const;
+	bool Load(const std::string& path);
+
+private:
+	struct Chunk
+	{
+		vec3_t origin;
+		vec3_t step;
+		vec3_t bounds_min;
+		vec3_t bounds_max;
+		uint64_t version;
+	};
+
+	struct ViewChunk
+	{
+		uint32_t view;
+		uint32_t chunk;
+	};
+
+	// Bounds of the dequantized points and a fresh version
+	void FinishChunk(size_t chunk);
+
+	// Captures the quantized chunks, a replay projects them with the same project_quantized kernel
+	void CaptureProjection(FrameCapture& capture, uint32_t view, const Camera& camera, const uint32_t* chunks, size_t chunk_count) const;
+
+private:
+	std::vector<uint16_t> m_x;
+	std::vector<uint16_t> m_y;
+	std::vector<uint16_t> m_z;
+
+	std::vector<Chunk> m_chunks;
+
+	mutable std::vector<ViewChunk> m_stale_view_chunks;
+	mutable std::vector<uint32_t> m_capture_chunks;
+};
@@ -1,4 +1,8 @@
 ﻿#include "projection.hpp"
+#include "clipping.hpp"
+#include "cpu_dispatch.hpp"
+
+#include <algorithm>
 
 Projection::Projection(): m_fov_factor(1500.0f) {};
 
@@ -25,7 +29,7 @@ vec2_t Projection::OrthographicProject(vec3_t point)
 	return projected_point;
 }
 
-vec2_t Projection::PerspectiveProject(vec3_t point)
+vec2_t Projection::PerspectiveProject(vec3_t point) const
 {
 	// Clamp z to near plane (prevents division by zero, infinity, and smaller values)
 	float z = point.z <= NEAR_PLANE ? point.z = NEAR_PLANE : point.z;
@@ -38,15 +42,43 @@ vec2_t Projection::PerspectiveProject(vec3_t point)
 	return projected_point;
 }
 
+bool Projection::ProjectSegment(vec3_t a, vec3_t b, vec2_t& out_a, vec2_t& out_b) const
+{
+	if (!ClipSegmentDepth(a, b, NEAR_PLANE, FAR_PLANE))
+		return false;
+
+	// Both ends are past the near plane now, the clamp in PerspectiveProject never kicks in
+	out_a = PerspectiveProject(a);
+	out_b = PerspectiveProject(b);
+
+	return true;
+}
+
+int Projection::ProjectTriangle(const vec3_t* triangle, vec2_t* out) const
+{
+	vec3_t clipped[CLIP_MAX_VERTICES];
+	int count = ClipPolygonDepth(triangle, 3, clipped, NEAR_PLANE, FAR_PLANE);
+
+	for (int i = 0; i < count; ++i)
+	{
+		out[i] = PerspectiveProject(clipped[i]);
+	}
+
+	return count;
+}
+
 void Projection::SetProjectedPoints(int idx, vec2_t& point)
 {
 	if (idx < m_projected_points.size())
 		m_projected_points[idx] = point;
+
+	InvalidateCache();
 }
 
 void Projection::ResizeProjectedPoints(size_t new_size)
 {
 	m_projected_points.resize(new_size);
+	InvalidateCache();
 }
 
 
@@ -66,7 +98,53 @@ void Projection::ProjectAllPoints(const vec3_t* world_points, int count, const v
 		point.z -= camera_position.z;
 		m_projected_points[i] = PerspectiveProject(point);
 	}
+
+	InvalidateCache();
 }
 
+void Projection::ProjectRange(const float* xs, const float* ys, const float* zs, size_t count,
+	const vec3_t& camera_position, vec2_t* out) const
+{
+	// Same near plane clamp as PerspectiveProject, vectorized per CPU path
+	GetCpuKernels().project(xs, ys, zs, count, camera_position, m_fov_factor, NEAR_PLANE, out);
+}
 
+void Projection::ProjectQuantizedRange(const uint16_t* xs, const uint16_t* ys, const uint16_t* zs, size_t count,
+	const vec3_t& origin, const vec3_t& step, const vec3_t& camera_position, vec2_t* out) const
+{
+	GetCpuKernels().project_quantized(xs, ys, zs, count, origin, step, camera_position, m_fov_factor, NEAR_PLANE, out);
+}
+
+// Versions never hand out this value, so it marks a chunk as not cached
+#define UNCACHED_VERSION UINT64_MAX
+
+void Projection::BeginCachedFrame(const vec3_t& camera_position, size_t point_count, size_t chunk_count)
+{
+	bool view_changed = camera_position.x != m_cached_camera.x || camera_position.y != m_cached_camera.y ||
+		camera_position.z != m_cached_camera.z || m_fov_factor != m_cached_fov;
+
+	if (point_count != m_projected_points.size())
+	{
+		m_projected_points.resize(point_count);
+		view_changed = true;
+	}
 
+	if (view_changed || m_cached_versions.size() != chunk_count)
+		m_cached_versions.assign(chunk_count, UNCACHED_VERSION);
+
+	m_cached_camera = camera_position;
+	m_cached_fov = m_fov_factor;
+	m_frame_changed = false;
+}
+
+void Projection::MarkChunkCached(size_t chunk, uint64_t version)
+{
+	m_cached_versions[chunk] = version;
+	m_frame_changed = true;
+}
+
+void Projection::InvalidateCache()
+{
+	std::fill(m_cached_versions.begin(), m_cached_versions.end(), UNCACHED_VERSION);
+	m_frame_changed = true;
+}
@@ -1,8 +1,11 @@
 ﻿#pragma once
 #include "vector.h"
+#include <stdint.h>
+#include <stddef.h>
 #include <vector>
 
 #define NEAR_PLANE 0.1f
+#define FAR_PLANE 1000.0f
 
 class Projection
 {
@@ -13,7 +16,12 @@ public:
 	Projection(float fov, size_t init_size);
 
 	vec2_t OrthographicProject(vec3_t point);
-	vec2_t PerspectiveProject(vec3_t point);
+	vec2_t PerspectiveProject(vec3_t point) const;
+
+	// Camera space primitives, clipped against near/far instead of clamped
+	bool ProjectSegment(vec3_t a, vec3_t b, vec2_t& out_a, vec2_t& out_b) const;
+	// out needs CLIP_MAX_VERTICES entries, returns the convex polygon vertex count (0 if culled)
+	int ProjectTriangle(const vec3_t* triangle, vec2_t* out) const;
 
 public:
 	std::vector<vec2_t>& GetProjectedPoints() { return m_projected_points; }
@@ -29,7 +37,33 @@ public:
 	vec2_t ToScreenSpace(const vec2_t& projected_point, int screen_width, int screen_height);
 	void ProjectAllPoints(const vec3_t* world_points, int count, const vec3_t& camera_position);
 
+	// Structure of arrays batch, safe to call concurrently on disjoint output ranges
+	void ProjectRange(const float* xs, const float* ys, const float* zs, size_t count,
+		const vec3_t& camera_position, vec2_t* out) const;
+
+	// Same for 16-bit quantized points (point = q * step + origin), dequantized inside the kernel.
+	// Gives exactly what ProjectRange gives for the dequantized floats
+	void ProjectQuantizedRange(const uint16_t* xs, const uint16_t* ys, const uint16_t* zs, size_t count,
+		const vec3_t& origin, const vec3_t& step, const vec3_t& camera_position, vec2_t* out) const;
+
+public:
+	// Cache of projected chunks. A chunk stays valid while camera, FOV, point count and its version match.
+	// Drops every chunk when the view key changed and starts a frame with HasFrameChanged() == false
+	void BeginCachedFrame(const vec3_t& camera_position, size_t point_count, size_t chunk_count);
+	bool IsChunkCached(size_t chunk, uint64_t version) const { return m_cached_versions[chunk] == version; }
+	void MarkChunkCached(size_t chunk, uint64_t version);
+	void InvalidateCache();
+
+	// False when nothing was reprojected since BeginCachedFrame, rasterization can be skipped
+	bool HasFrameChanged() const { return m_frame_changed; }
+
 private:
 	std::vector<vec2_t> m_projected_points;
 	float m_fov_factor;
+
+	// Projection cache
+	std::vector<uint64_t> m_cached_versions;
+	vec3_t m_cached_camera;
+	float m_cached_fov = 0.0f;
+	bool m_frame_changed = true;
 };
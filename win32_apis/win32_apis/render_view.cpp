@@ -0,0 +1,50 @@
+﻿#include <algorithm>
+
+#include "render_view.hpp"
+
+void LayoutViewGrid(int width, int height, int columns, int rows, std::vector<Viewport>& viewports)
+{
+	viewports.clear();
+	if (width <= 0 || height <= 0 || columns <= 0 || rows <= 0)
+		return;
+
+	const int cell_width = width / columns;
+	const int cell_height = height / rows;
+
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int column = 0; column < columns; ++column)
+		{
+			Viewport viewport;
+			viewport.x = column * cell_width;
+			viewport.y = row * cell_height;
+			viewport.width = column == columns - 1 ? width - viewport.x : cell_width;
+			viewport.height = row == rows - 1 ? height - viewport.y : cell_height;
+
+			viewports.push_back(viewport);
+		}
+	}
+}
+
+bool IsBoxInView(const vec3_t& box_min, const vec3_t& box_max, const Camera& camera, const Viewport& viewport, float margin)
+{
+	// Camera space, depth clamped to the near plane the same way ProjectRange does
+	const float x0 = box_min.x - camera.position.x, x1 = box_max.x - camera.position.x;
+	const float y0 = box_min.y - camera.position.y, y1 = box_max.y - camera.position.y;
+	const float z0 = std::max(box_min.z - camera.position.z, NEAR_PLANE);
+	const float z1 = std::max(box_max.z - camera.position.z, NEAR_PLANE);
+
+	// x / z is monotonic in x and z for z > 0, so the projected extremes are at the corners
+	const float inv_z0 = camera.fov_factor / z0, inv_z1 = camera.fov_factor / z1;
+
+	const float sx_min = std::min({ x0 * inv_z0, x0 * inv_z1, x1 * inv_z0, x1 * inv_z1 });
+	const float sx_max = std::max({ x0 * inv_z0, x0 * inv_z1, x1 * inv_z0, x1 * inv_z1 });
+	const float sy_min = std::min({ y0 * inv_z0, y0 * inv_z1, y1 * inv_z0, y1 * inv_z1 });
+	const float sy_max = std::max({ y0 * inv_z0, y0 * inv_z1, y1 * inv_z0, y1 * inv_z1 });
+
+	// Projected points are centered on the viewport
+	const float half_width = viewport.width * 0.5f + margin;
+	const float half_height = viewport.height * 0.5f + margin;
+
+	return sx_max >= -half_width && sx_min <= half_width && sy_max >= -half_height && sy_min <= half_height;
+}
@@ -0,0 +1,41 @@
+﻿#pragma once
+#include <stdint.h>
+#include <vector>
+
+#include "vector.h"
+#include "projection.hpp"
+
+// Pixel rectangle of the shared framebuffer
+struct Viewport
+{
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+};
+
+struct Camera
+{
+	vec3_t position;
+	float fov_factor = 1500.0f;
+};
+
+// One camera drawn into one viewport. Views share the scene (EntityStore) and the framebuffer,
+// everything per camera lives here
+struct RenderView
+{
+	Viewport viewport;
+	Camera camera;
+
+	// Projected points indexed like the EntityStore (or PointCloud), with their own chunk cache
+	Projection projection;
+
+	// Per chunk: survived culling against this view last frame (see EntityStore::ProjectViews, PointCloud::ProjectViews)
+	std::vector<uint8_t> visible_chunks;
+};
+
+// Splits width x height into a columns x rows grid, row major. Leftover pixels go to the last row/column
+void LayoutViewGrid(int width, int height, int columns, int rows, std::vector<Viewport>& viewports);
+
+// True if any point inside the box can project within margin pixels of the viewport
+bool IsBoxInView(const vec3_t& box_min, const vec3_t& box_max, const Camera& camera, const Viewport& viewport, float margin);
@@ -1,15 +1,199 @@
 ﻿#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <vector>
 
 #include "renderer.hpp"
+#include "clipping.hpp"
+#include "job_system.hpp"
 
-Renderer::Renderer() : m_front_buffer(nullptr), m_back_buffer(nullptr),
+namespace
+{
+	// Fills storage pixels [first, first + count), layout agnostic
+	template<typename View>
+	void ClearKernel(const View& view, size_t first, size_t count, uint32_t color)
+	{
+		PerfCounters::Add(PerfCounter::PixelsFilled, count);
+
+		if constexpr (View::format_t::format == PixelFormat::ARGB8888)
+			GetCpuKernels().fill(view.pixels + first, count, color);
+		else
+			std::fill(view.pixels + first, view.pixels + first + count, View::format_t::Encode(color));
+	}
+
+	template<typename View>
+	void PresentKernel(const View& view, uint32_t* front_buffer)
+	{
+		typedef typename View::format_t Format;
+		typedef typename View::layout_t Layout;
+
+		if (Format::format == PixelFormat::ARGB8888 && Layout::layout == FramebufferLayout::Linear)
+		{
+			std::memcpy(front_buffer, view.pixels, static_cast<size_t>(view.width) * view.height * sizeof(uint32_t));
+			return;
+		}
+
+		if (Layout::layout == FramebufferLayout::Linear)
+		{
+			const size_t count = static_cast<size_t>(view.width) * view.height;
+			for (size_t i = 0; i < count; ++i)
+			{
+				front_buffer[i] = Format::Decode(view.pixels[i]);
+			}
+			return;
+		}
+
+		// Walk tile by tile so reads stay sequential, writes go one tile row at a time
+		for (int ty = 0; ty < view.height; ty += FRAMEBUFFER_TILE_SIZE)
+		{
+			const int y_end = std::min(ty + FRAMEBUFFER_TILE_SIZE, view.height);
+
+			for (int tx = 0; tx < view.width; tx += FRAMEBUFFER_TILE_SIZE)
+			{
+				const int x_end = std::min(tx + FRAMEBUFFER_TILE_SIZE, view.width);
+
+				for (int y = ty; y < y_end; ++y)
+				{
+					const typename View::pixel_t* src = view.At(tx, y);
+					uint32_t* dst = front_buffer + static_cast<size_t>(y) * view.width;
+
+					for (int x = tx; x < x_end; ++x)
+					{
+						dst[x] = Format::Decode(*src++);
+					}
+				}
+			}
+		}
+	}
+
+	// Clip then rasterize with integer Bresenham, endpoints land inside the viewport
+	template<BlendMode Mode, typename View>
+	void DrawClippedLine(const View& view, vec2_t a, vec2_t b, uint32_t color)
+	{
+		const ClipRect viewport = { 0.0f, 0.0f, view.width - 1.0f, view.height - 1.0f };
+		if (!ClipSegmentRect(a, b, viewport))
+			return;
+
+		DrawLineKernel<Mode>(view,
+			static_cast<int>(a.x + 0.5f), static_cast<int>(a.y + 0.5f),
+			static_cast<int>(b.x + 0.5f), static_cast<int>(b.y + 0.5f),
+			color);
+	}
+
+	template<BlendMode Mode, typename View>
+	void DrawPolylineKernel(const View& view, const vec2_t* points, int count, bool closed, uint32_t color)
+	{
+		for (int i = 0; i + 1 < count; ++i)
+		{
+			DrawClippedLine<Mode>(view, points[i], points[i + 1], color);
+		}
+
+		if (closed && count > 2)
+			DrawClippedLine<Mode>(view, points[count - 1], points[0], color);
+	}
+
+	template<BlendMode Mode, typename View>
+	void DrawWireframeKernel(const View& view, const vec2_t* points, size_t point_count,
+		const MeshEdge* edges, size_t edge_count, vec2_t origin, uint32_t color)
+	{
+		for (size_t i = 0; i < edge_count; ++i)
+		{
+			const MeshEdge& edge = edges[i];
+			if (edge.a >= point_count || edge.b >= point_count)
+				continue;
+
+			vec2_t a(points[edge.a].x + origin.x, points[edge.a].y + origin.y);
+			vec2_t b(points[edge.b].x + origin.x, points[edge.b].y + origin.y);
+			DrawClippedLine<Mode>(view, a, b, color);
+		}
+	}
+
+	// Row major so every row is touched once: grid rows are spans, the rest only the columns
+	template<BlendMode Mode, typename View>
+	void DrawGridKernel(const View& view, int spacing, uint32_t color)
+	{
+		for (int y = 0; y < view.height; ++y)
+		{
+			if (y % spacing == 0)
+			{
+				FillSpanKernel<Mode, ClipMode::None>(view, 0, y, view.width, color);
+				continue;
+			}
+
+			for (int x = 0; x < view.width; x += spacing)
+			{
+				PutPixelKernel<Mode, ClipMode::None>(view, x, y, color);
+			}
+		}
+	}
+
+	// Captures cannot point into the caller's atlas: every rect's pixels are stacked into one mask and the
+	// rects rewritten to match. Split so row offsets still fit AlphaMaskRect::src_y
+	void RecordAlphaMasks(FrameCapture& capture, int x, int y, const uint8_t* mask, int mask_stride,
+		const AlphaMaskRect* rects, size_t count, uint32_t color)
+	{
+		std::vector<AlphaMaskRect> packed_rects;
+		std::vector<uint8_t> packed;
+
+		size_t first = 0;
+		while (first < count)
+		{
+			int stride = 1;
+			size_t rows = 0;
+			size_t last = first;
+			for (; last < count && rows + rects[last].height <= UINT16_MAX; ++last)
+			{
+				stride = std::max(stride, static_cast<int>(rects[last].width));
+				rows += rects[last].height;
+			}
+
+			packed_rects.assign(rects + first, rects + last);
+			packed.assign(rows * stride, 0);
+
+			uint16_t top = 0;
+			for (AlphaMaskRect& rect : packed_rects)
+			{
+				for (int row = 0; row < rect.height; ++row)
+				{
+					std::memcpy(packed.data() + static_cast<size_t>(top + row) * stride,
+						mask + static_cast<size_t>(rect.src_y + row) * mask_stride + rect.src_x, rect.width);
+				}
+
+				rect.src_x = 0;
+				rect.src_y = top;
+				top = static_cast<uint16_t>(top + rect.height);
+			}
+
+			capture.Record(CaptureRecord::AlphaMasks, x, y, color, stride,
+				MakeCaptureSpan(packed_rects.data(), packed_rects.size()), MakeCaptureSpan(packed.data(), packed.size()));
+			first = last;
+		}
+	}
+
+	// Projected points are relative to the viewport center, like the binned points in the demo
+	vec2_t GetViewportCenter(const Viewport& viewport)
+	{
+		return vec2_t(static_cast<float>(viewport.x + viewport.width / 2), static_cast<float>(viewport.y + viewport.height / 2));
+	}
+
+	// Pixel centers a line may land on
+	ClipRect GetLineScissor(const Viewport& viewport)
+	{
+		return { static_cast<float>(viewport.x), static_cast<float>(viewport.y),
+			static_cast<float>(viewport.x + viewport.width - 1), static_cast<float>(viewport.y + viewport.height - 1) };
+	}
+}
+
+Renderer::Renderer() : m_front_buffer(nullptr), m_back_buffer(nullptr), m_back_buffer_pixels(0), m_tiles_x(0),
+						m_format(PixelFormat::ARGB8888), m_layout(FramebufferLayout::Linear),
 						m_monitor{ 0,0 }, m_back_buffer_init(false) {}
 Renderer::~Renderer()
 {
 	// Note: We don't delete m_color_buffer since it's owned by the platform adapter
 }
 
-void Renderer::Initialize(uint32_t* color_buffer, int width, int height)
+void Renderer::Initialize(uint32_t* color_buffer, int width, int height, PixelFormat format, FramebufferLayout layout)
 {
 	if (!color_buffer) return;
 	if (width <= 0 || height <= 0) return;
@@ -17,20 +201,59 @@ void Renderer::Initialize(uint32_t* color_buffer, int width, int height)
 	m_front_buffer = color_buffer;
 	m_monitor.buffer_width = width;
 	m_monitor.buffer_height = height;
+	m_format = format;
+	m_layout = layout;
+
+	// Tiled buffers are padded up to whole tiles
+	m_tiles_x = (width + FRAMEBUFFER_TILE_SIZE - 1) / FRAMEBUFFER_TILE_SIZE;
+	if (m_layout == FramebufferLayout::Tiled)
+	{
+		int tiles_y = (height + FRAMEBUFFER_TILE_SIZE - 1) / FRAMEBUFFER_TILE_SIZE;
+		m_back_buffer_pixels = static_cast<size_t>(m_tiles_x) * tiles_y * FRAMEBUFFER_TILE_SIZE * FRAMEBUFFER_TILE_SIZE;
+	}
+	else
+	{
+		m_back_buffer_pixels = static_cast<size_t>(width) * height;
+	}
 
-	size_t size_buffer = static_cast<size_t>(width * height);
-	m_back_buffer = new uint32_t[size_buffer];
+	if (!m_back_memory.Allocate(m_back_buffer_pixels * GetPixelSize(m_format), m_memory_options.huge_pages))
+	{
+		std::cerr << "Failed to allocate the back buffer!\n";
+		m_back_buffer = nullptr;
+		m_back_buffer_init = false;
+		return;
+	}
+
+	m_back_buffer = m_back_memory.Get();
 	m_back_buffer_init = true;
+	m_front_buffer_stale = true;
+
+	if (!m_memory_options.first_touch)
+	{
+		ClearColorBuffer(0xFFFFFFFF);
+		return;
+	}
+
+	// First write decides which node backs each page, so clear in bands of rows from the workers.
+	// Storage is row major for Linear and tile row major for Tiled, a band is contiguous either way
+	const size_t row_pixels = m_layout == FramebufferLayout::Tiled ?
+		static_cast<size_t>(m_tiles_x) * FRAMEBUFFER_TILE_SIZE : static_cast<size_t>(width);
+	const size_t band_pixels = row_pixels * std::max(m_memory_options.band_rows, 1);
+	const size_t pixel_count = m_back_buffer_pixels;
 
-	ClearColorBuffer(0xFFFFFFFF);
+	m_memory_options.first_touch->ParallelFor(pixel_count, band_pixels, [this](size_t begin, size_t end)
+	{
+		DispatchFormat([begin, end](const auto& view) { ClearKernel(view, begin, end - begin, 0xFFFFFFFF); });
+	});
 }
 
 void Renderer::Shutdown()
 {
 	if (m_back_buffer && m_back_buffer_init)
 	{
-		delete[] m_back_buffer;
+		m_back_memory.Free();
 		m_back_buffer = nullptr;
+		m_back_buffer_pixels = 0;
 		m_back_buffer_init = false;
 	}
 
@@ -39,98 +262,366 @@ void Renderer::Shutdown()
 	m_monitor.buffer_height = 0;
 }
 
-void Renderer::SwapBuffers()
+bool Renderer::SwapBuffers()
 {
-	if (!m_back_buffer || !m_back_buffer) return;
-	if (m_monitor.buffer_width <= 0 || m_monitor.buffer_height <= 0) return;
+	if (!m_front_buffer || !m_back_buffer) return false;
+	if (m_monitor.buffer_width <= 0 || m_monitor.buffer_height <= 0) return false;
+
+	// The overlay changes every frame and would blend over its previous self
+	bool skip = m_skip_frame && !m_front_buffer_stale && !m_overlay;
+	m_skip_frame = false;
 
-	size_t buffer_size = m_monitor.buffer_width * m_monitor.buffer_height;
-	std::memcpy(m_front_buffer, m_back_buffer, buffer_size * sizeof(uint32_t));
+	if (!skip)
+	{
+		PerfScope scope(PerfCounter::PresentTime);
+
+		uint32_t* front_buffer = m_front_buffer;
+		DispatchFormat([front_buffer](const auto& view) { PresentKernel(view, front_buffer); });
+		m_front_buffer_stale = false;
+	}
+
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Present(!skip, m_front_buffer, static_cast<size_t>(m_monitor.buffer_width) * m_monitor.buffer_height);
+
+	if (m_overlay)
+		DrawOverlay();
+
+	return !skip;
+}
+
+void Renderer::DrawOverlay()
+{
+	// Front buffer view of its own, renderer state and the active capture stay untouched
+	const OverlayView target = { m_front_buffer, m_monitor.buffer_width, m_monitor.buffer_height, 0 };
+	m_overlay->DrawOverlay(target);
+}
+
+void Renderer::SkipFrame()
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::Skip);
+
+	m_skip_frame = true;
+}
+
+void Renderer::SetFrontBuffer(uint32_t* color_buffer)
+{
+	if (!color_buffer || color_buffer == m_front_buffer)
+		return;
+
+	m_front_buffer = color_buffer;
+	m_front_buffer_stale = true;
 }
 
 void Renderer::ClearColorBuffer(uint32_t color)
 {
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::Clear, color);
 
 	if (!m_back_buffer) return;
 	if (m_monitor.buffer_width <= 0 || m_monitor.buffer_height <= 0) return;
 
-	for (int i = 0; i < m_monitor.buffer_width * m_monitor.buffer_height; ++i)
-	{
-		m_back_buffer[i] = color;
-	}
+	size_t pixel_count = m_back_buffer_pixels;
+	// Tiles are padded, fill the whole allocation so the padding stays defined
+	DispatchFormat([pixel_count, color](const auto& view) { ClearKernel(view, 0, pixel_count, color); });
 
 }
 
 void Renderer::DrawPixel(int x, int y, uint32_t color)
 {
-	if (x < 0 || x >= m_monitor.buffer_width || y < 0 || y >= m_monitor.buffer_height)
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::Pixel, x, y, color);
+
+	if (!m_back_buffer)
 		return;
 
-	uint32_t* pixel = &m_back_buffer[y * m_monitor.buffer_width + x];
+	DispatchFormat([=](const auto& view) { PlotPixelKernel(view, x, y, color); });
+}
 
-	// Extract ARGB components
-	// 0xAARRGGBB >> 24 = 0x000000AA
-	uint8_t src_a = (color >> 24) & 0xFF;
-	// 0xAARRGGBB >> 16 = 0x0000AARR
-	uint8_t src_r = (color >> 16) & 0xFF;
-	// 0xAARRGGBB >> 8 = 0x00AARRGG
-	uint8_t src_g = (color >> 8) & 0xFF;
-	// 0xAARRGGBB >> 0xAARRGGBB
-	uint8_t src_b = color & 0xFF;
+void Renderer::ReadTile(int x, int y, int width, int height, uint32_t* pixels, int stride) const
+{
+	if (!m_back_buffer || !pixels)
+		return;
 
-	if (src_a == 255) {
-		// Fully opaque - just replace
-		*pixel = color;
-	}
-	else if (src_a > 0) {
-		// Alpha blend manually
-		uint32_t dst = *pixel;
-		uint8_t dst_r = (dst >> 16) & 0xFF;
-		uint8_t dst_g = (dst >> 8) & 0xFF;
-		uint8_t dst_b = dst & 0xFF;
+	// Keep pixels[0] mapped to (x, y) while clipping
+	int x0 = std::max(x, 0), y0 = std::max(y, 0);
+	int x1 = std::min(x + width, m_monitor.buffer_width), y1 = std::min(y + height, m_monitor.buffer_height);
+	if (x1 <= x0 || y1 <= y0)
+		return;
 
-		// Normal / Over blending
-		uint8_t inv_alpha = 255 - src_a;
-		uint8_t final_r = (src_r * src_a + dst_r * inv_alpha) / 255; // <-- Divided by 255 to be normalized
-		uint8_t final_g = (src_g * src_a + dst_g * inv_alpha) / 255;
-		uint8_t final_b = (src_b * src_a + dst_b * inv_alpha) / 255;
+	pixels += static_cast<size_t>(y0 - y) * stride + (x0 - x);
+	DispatchFormat([=](const auto& view) { ReadTileKernel(view, x0, y0, x1 - x0, y1 - y0, pixels, stride); });
+}
 
-		*pixel = 0xFF000000 | (final_r << 16) | (final_g << 8) | final_b;
-	}
-	// If src_a == 0, don't draw anything
+void Renderer::WriteTile(int x, int y, int width, int height, const uint32_t* pixels, int stride)
+{
+	if (!m_back_buffer || !pixels)
+		return;
+
+	int x0 = std::max(x, 0), y0 = std::max(y, 0);
+	int x1 = std::min(x + width, m_monitor.buffer_width), y1 = std::min(y + height, m_monitor.buffer_height);
+	if (x1 <= x0 || y1 <= y0)
+		return;
+
+	pixels += static_cast<size_t>(y0 - y) * stride + (x0 - x);
+	DispatchFormat([=](const auto& view) { WriteTileKernel(view, x0, y0, x1 - x0, y1 - y0, pixels, stride); });
 }
 
 void Renderer::DrawGrid(uint32_t color, int spacing)
 {
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::Grid, color, spacing);
+
 	if (!m_back_buffer)
 		return;
 
 	if (m_monitor.buffer_width <= 0 || m_monitor.buffer_height <= 0)
 		return;
 
-	// Vertical lines
-	for (int dy = 0; dy <= m_monitor.buffer_width; dy += spacing)
+	if (spacing <= 0)
+		return;
+
+	if (((color >> 24) & 0xFF) == 255)
+		DispatchFormat([=](const auto& view) { DrawGridKernel<BlendMode::Opaque>(view, spacing, color); });
+	else
+		DispatchFormat([=](const auto& view) { DrawGridKernel<BlendMode::Alpha>(view, spacing, color); });
+}
+
+void Renderer::DrawRectangle(int x, int y, int width, int height, uint32_t color)
+{
+	if (!m_back_buffer)
+		return;
+
+	// Alpha is constant over the rectangle, pick the kernel once instead of per pixel
+	uint8_t src_a = (color >> 24) & 0xFF;
+	if (src_a == 0)
+		return;
+
+	// Width and height are inclusive, FillRect clips to the viewport once up front
+	if (src_a == 255)
+		FillRect<BlendMode::Opaque>(x, y, width + 1, height + 1, color);
+	else
+		FillRect<BlendMode::Alpha>(x, y, width + 1, height + 1, color);
+}
+
+void Renderer::DrawTriangle(const vec2_t& a, const vec2_t& b, const vec2_t& c, uint32_t color)
+{
+	const vec2_t triangle[3] = { a, b, c };
+	DrawConvexPolygon(triangle, 3, color);
+}
+
+void Renderer::DrawConvexPolygon(const vec2_t* points, int count, uint32_t color)
+{
+	// DrawTriangle lands here, the rectangle and line entry points record through FillRect / DrawPolyline
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::Polygon, color, MakeCaptureSpan(points, points ? std::max(count, 0) : 0));
+
+	if (!m_back_buffer || !points || count < 3)
+		return;
+
+	uint8_t src_a = (color >> 24) & 0xFF;
+	if (src_a == 0)
+		return;
+
+	float min_x = points[0].x, max_x = points[0].x;
+	float min_y = points[0].y, max_y = points[0].y;
+	for (int i = 1; i < count; ++i)
+	{
+		min_x = std::min(min_x, points[i].x);
+		max_x = std::max(max_x, points[i].x);
+		min_y = std::min(min_y, points[i].y);
+		max_y = std::max(max_y, points[i].y);
+	}
+
+	const float width = static_cast<float>(m_monitor.buffer_width);
+	const float height = static_cast<float>(m_monitor.buffer_height);
+
+	// Fully off-screen
+	if (max_x < 0.0f || max_y < 0.0f || min_x >= width || min_y >= height)
+	{
+		PerfCounters::Add(PerfCounter::PrimitivesCulled, 1);
+		return;
+	}
+
+	// Only polygons poking out of the guard band are clipped, the rest is scissored by the kernel.
+	// Clipping adds at most one vertex per edge of the band
+	vec2_t local[CLIP_MAX_VERTICES];
+	const ClipRect guard_band = { -GUARD_BAND_MARGIN, -GUARD_BAND_MARGIN, width + GUARD_BAND_MARGIN, height + GUARD_BAND_MARGIN };
+
+	if (min_x < guard_band.min_x || min_y < guard_band.min_y || max_x > guard_band.max_x || max_y > guard_band.max_y)
 	{
-		for (int dx = 0; dx <= m_monitor.buffer_width; dx += spacing)
+		vec2_t* clipped = local;
+		if (count + 4 > CLIP_MAX_VERTICES)
 		{
-			DrawPixel(dx, dy, color);
+			m_clip_vertices.resize(count + 4);
+			clipped = m_clip_vertices.data();
 		}
+
+		count = ClipPolygonRect(points, count, clipped, guard_band);
+		points = clipped;
 	}
+
+	PerfCounters::Add(PerfCounter::PrimitivesDrawn, 1);
+
+	if (src_a == 255)
+		DispatchFormat([=](const auto& view) { FillConvexPolygonKernel<BlendMode::Opaque>(view, points, count, color); });
+	else
+		DispatchFormat([=](const auto& view) { FillConvexPolygonKernel<BlendMode::Alpha>(view, points, count, color); });
 }
 
-void Renderer::DrawRectangle(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint32_t color)
+void Renderer::DrawLine(int x0, int y0, int x1, int y1, uint32_t color)
 {
-	if (!m_back_buffer)
+	DrawLine(vec2_t(static_cast<float>(x0), static_cast<float>(y0)), vec2_t(static_cast<float>(x1), static_cast<float>(y1)), color);
+}
+
+void Renderer::DrawLine(const vec2_t& a, const vec2_t& b, uint32_t color)
+{
+	const vec2_t segment[2] = { a, b };
+	DrawPolyline(segment, 2, color);
+}
+
+void Renderer::DrawLineAA(const vec2_t& a, const vec2_t& b, uint32_t color)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::LineAA, a, b, color);
+
+	if (!m_back_buffer || ((color >> 24) & 0xFF) == 0)
+		return;
+
+	// Clipped once, inset by a pixel: Wu also covers the pixel beside the ideal line and plots unchecked
+	vec2_t start = a;
+	vec2_t end = b;
+	const ClipRect viewport = { 1.0f, 1.0f, m_monitor.buffer_width - 2.0f, m_monitor.buffer_height - 2.0f };
+	if (viewport.max_x < viewport.min_x || viewport.max_y < viewport.min_y || !ClipSegmentRect(start, end, viewport))
 		return;
 
-	for (int dy = 0; dy <= height; dy++)
+	DispatchFormat([=](const auto& view) { DrawLineAAKernel(view, start.x, start.y, end.x, end.y, color); });
+}
+
+void Renderer::DrawPolyline(const vec2_t* points, int count, uint32_t color, bool closed)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::Polyline, color, static_cast<uint8_t>(closed), MakeCaptureSpan(points, points ? std::max(count, 0) : 0));
+
+	if (!m_back_buffer || !points || count < 2)
+		return;
+
+	uint8_t src_a = (color >> 24) & 0xFF;
+	if (src_a == 0)
+		return;
+
+	// One dispatch for the whole batch
+	if (src_a == 255)
+		DispatchFormat([=](const auto& view) { DrawPolylineKernel<BlendMode::Opaque>(view, points, count, closed, color); });
+	else
+		DispatchFormat([=](const auto& view) { DrawPolylineKernel<BlendMode::Alpha>(view, points, count, closed, color); });
+}
+
+void Renderer::DrawWireframe(const vec2_t* points, size_t point_count, const MeshEdge* edges, size_t edge_count,
+	uint32_t color, const vec2_t& origin)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::Wireframe, color, origin,
+			MakeCaptureSpan(points, points ? point_count : 0), MakeCaptureSpan(edges, edges ? edge_count : 0));
+
+	if (!m_back_buffer || !points || !edges)
+		return;
+
+	uint8_t src_a = (color >> 24) & 0xFF;
+	if (src_a == 0)
+		return;
+
+	if (src_a == 255)
+		DispatchFormat([=](const auto& view) { DrawWireframeKernel<BlendMode::Opaque>(view, points, point_count, edges, edge_count, origin, color); });
+	else
+		DispatchFormat([=](const auto& view) { DrawWireframeKernel<BlendMode::Alpha>(view, points, point_count, edges, edge_count, origin, color); });
+}
+
+void Renderer::DrawLine3D(const Projection& projection, const Viewport& viewport, const vec3_t& a, const vec3_t& b, uint32_t color)
+{
+	vec2_t start, end;
+	if (!projection.ProjectSegment(a, b, start, end))
+		return;
+
+	const vec2_t center = GetViewportCenter(viewport);
+	start = vec2_t(start.x + center.x, start.y + center.y);
+	end = vec2_t(end.x + center.x, end.y + center.y);
+
+	if (ClipSegmentRect(start, end, GetLineScissor(viewport)))
+		DrawLine(start, end, color);
+}
+
+void Renderer::DrawTriangle3D(const Projection& projection, const Viewport& viewport, const vec3_t* triangle, uint32_t color)
+{
+	// A triangle clipped against near/far has at most 5 vertices, 4 more rect edges still fit CLIP_MAX_VERTICES
+	vec2_t projected[CLIP_MAX_VERTICES];
+	int count = projection.ProjectTriangle(triangle, projected);
+	if (count < 3)
+		return;
+
+	const vec2_t center = GetViewportCenter(viewport);
+	for (int i = 0; i < count; ++i)
 	{
-		for (int dx = 0; dx <= width; dx++)
-		{
-			int new_x = x + dx;
-			int new_y = y + dy;
+		projected[i] = vec2_t(projected[i].x + center.x, projected[i].y + center.y);
+	}
 
-			DrawPixel(new_x, new_y, color);
-		}
+	// Polygons cover pixel centers, so the scissor is the viewport's outer edge
+	const ClipRect scissor = { static_cast<float>(viewport.x), static_cast<float>(viewport.y),
+		static_cast<float>(viewport.x + viewport.width), static_cast<float>(viewport.y + viewport.height) };
+
+	vec2_t clipped[CLIP_MAX_VERTICES];
+	count = ClipPolygonRect(projected, count, clipped, scissor);
+	if (count >= 3)
+		DrawConvexPolygon(clipped, count, color);
+}
+
+void Renderer::DrawWireframe3D(const Projection& projection, const Viewport& viewport, const vec3_t* points, size_t point_count,
+	const MeshEdge* edges, size_t edge_count, uint32_t color)
+{
+	if (!points || !edges)
+		return;
+
+	const vec2_t center = GetViewportCenter(viewport);
+	const ClipRect scissor = GetLineScissor(viewport);
+
+	// Every edge is clipped on its own, a vertex behind the camera only shortens the edges that reach it
+	m_wire_points.clear();
+	m_wire_edges.clear();
+	for (size_t i = 0; i < edge_count; ++i)
+	{
+		const MeshEdge& edge = edges[i];
+		if (edge.a >= point_count || edge.b >= point_count)
+			continue;
+
+		vec2_t start, end;
+		if (!projection.ProjectSegment(points[edge.a], points[edge.b], start, end))
+			continue;
+
+		start = vec2_t(start.x + center.x, start.y + center.y);
+		end = vec2_t(end.x + center.x, end.y + center.y);
+		if (!ClipSegmentRect(start, end, scissor))
+			continue;
+
+		const uint32_t first = static_cast<uint32_t>(m_wire_points.size());
+		m_wire_points.push_back(start);
+		m_wire_points.push_back(end);
+		m_wire_edges.push_back({ first, first + 1 });
 	}
-}
\ No newline at end of file
+
+	if (!m_wire_edges.empty())
+		DrawWireframe(m_wire_points.data(), m_wire_points.size(), m_wire_edges.data(), m_wire_edges.size(), color);
+}
+
+void Renderer::DrawAlphaMasks(int x, int y, const uint8_t* mask, int mask_stride, const AlphaMaskRect* rects, size_t count, uint32_t color)
+{
+	if (!mask || !rects)
+		return;
+
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		RecordAlphaMasks(*capture, x, y, mask, mask_stride, rects, count, color);
+
+	if (!m_back_buffer || ((color >> 24) & 0xFF) == 0)
+		return;
+
+	DispatchFormat([=](const auto& view) { BlendAlphaMasksKernel(view, x, y, mask, mask_stride, rects, count, color); });
+}
@@ -1,5 +1,20 @@
 ﻿#pragma once
 #include <stdint.h>
+#include <vector>
+
+#include "pixel_format.hpp"
+#include "draw_kernels.hpp"
+#include "vector.h"
+#include "mesh.hpp"
+#include "projection.hpp"
+#include "render_view.hpp"
+#include "framebuffer_memory.hpp"
+#include "frame_capture.hpp"
+#include "irender_overlay.hpp"
+#include "perf_counters.hpp"
+
+// Screen space slack around the viewport before triangles get clipped geometrically
+#define GUARD_BAND_MARGIN 4096.0f
 
 class Renderer
 {
@@ -8,9 +23,18 @@ public:
 	~Renderer();
 
 public:
-	void Initialize(uint32_t* color_buffer, int width, int height);
+	// color_buffer is the 32-bit ARGB presentation target; the back buffer uses format/layout
+	void Initialize(uint32_t* color_buffer, int width, int height,
+		PixelFormat format = PixelFormat::ARGB8888, FramebufferLayout layout = FramebufferLayout::Linear);
 	void Shutdown();
 
+	// Back buffer allocation and placement, takes effect on the next Initialize
+	void SetMemoryOptions(const FramebufferMemoryOptions& options) { m_memory_options = options; }
+	bool UsesHugePages() const { return m_back_memory.UsesHugePages(); }
+
+	// Drawn into the front buffer after every present (e.g. PerfHud), null to disable. While set no frame is skipped
+	void SetOverlay(IRenderOverlay* overlay) { m_overlay = overlay; }
+
 private:
 	struct monitor
 	{
@@ -22,19 +46,174 @@ public:
 	int GetBufferWidth() const { return m_monitor.buffer_width; }
 	int GetBufferHeight() const { return m_monitor.buffer_height; }
 
+	PixelFormat GetPixelFormat() const { return m_format; }
+	FramebufferLayout GetLayout() const { return m_layout; }
+
 public:
 	void ClearColorBuffer(uint32_t color);
 	void DrawPixel(int x, int y, uint32_t color);
 	void DrawGrid(uint32_t color, int spacing = 10);
-	void DrawRectangle(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint32_t color);
+	void DrawRectangle(int x, int y, int width, int height, uint32_t color);
+
+	// Screen space convex polygons of any vertex count, clipped to the guard band then scissored to the viewport
+	void DrawTriangle(const vec2_t& a, const vec2_t& b, const vec2_t& c, uint32_t color);
+	void DrawConvexPolygon(const vec2_t* points, int count, uint32_t color);
+
+	// Lines are clipped to the viewport once, the rasterizers never bounds check
+	void DrawLine(int x0, int y0, int x1, int y1, uint32_t color);
+	void DrawLine(const vec2_t& a, const vec2_t& b, uint32_t color);
+	void DrawLineAA(const vec2_t& a, const vec2_t& b, uint32_t color);
+	void DrawPolyline(const vec2_t* points, int count, uint32_t color, bool closed = false);
+
+	// Mesh edges over projected points, origin is added to every point (e.g. the screen center)
+	void DrawWireframe(const vec2_t* points, size_t point_count, const MeshEdge* edges, size_t edge_count,
+		uint32_t color, const vec2_t& origin = vec2_t());
+
+	// Camera space geometry (camera at the origin, +z into the screen) drawn centered in viewport and clipped to it.
+	// Depth is clipped before the divide (Projection::ProjectSegment / ProjectTriangle), so geometry behind the
+	// camera or crossing the near plane is cut off instead of clamped onto the screen
+	void DrawLine3D(const Projection& projection, const Viewport& viewport, const vec3_t& a, const vec3_t& b, uint32_t color);
+	void DrawTriangle3D(const Projection& projection, const Viewport& viewport, const vec3_t* triangle, uint32_t color);
+	void DrawWireframe3D(const Projection& projection, const Viewport& viewport, const vec3_t* points, size_t point_count,
+		const MeshEdge* edges, size_t edge_count, uint32_t color);
+
+	// Color through 8-bit coverage (mask_stride bytes per row), each rect's part of mask lands at (x + rect.x, y + rect.y).
+	// One call draws a whole batch, e.g. every glyph of a string (see TextRenderer)
+	void DrawAlphaMasks(int x, int y, const uint8_t* mask, int mask_stride, const AlphaMaskRect* rects, size_t count, uint32_t color);
+
+public:
+	// Specialized entry points, blend mode and clipping are fixed at compile time
+	template<BlendMode Mode, ClipMode Clip = ClipMode::Clip>
+	void DrawPixel(int x, int y, uint32_t color);
+	template<BlendMode Mode, ClipMode Clip = ClipMode::Clip>
+	void FillSpan(int x, int y, int length, uint32_t color);
+	template<BlendMode Mode, ClipMode Clip = ClipMode::Clip>
+	void FillRect(int x, int y, int width, int height, uint32_t color);
+
+	// Typed back buffer for callers that also know the format, pixels is null on mismatch
+	template<typename Format, typename Layout>
+	FramebufferView<Format, Layout> GetView() const;
+
+	// Rect transfer in 0xAARRGGBB with a row stride in pixels, clipped to the buffer.
+	// Used by the binning rasterizer to load and write back its tiles
+	void ReadTile(int x, int y, int width, int height, uint32_t* pixels, int stride) const;
+	void WriteTile(int x, int y, int width, int height, const uint32_t* pixels, int stride);
 
 public:
-	void SwapBuffers();
+	// Converts the back buffer to linear ARGB into the front buffer.
+	// Returns false when the frame was skipped and the front buffer already holds it
+	bool SwapBuffers();
+
+	// Nothing was drawn this frame, the next SwapBuffers can keep the previous image
+	void SkipFrame();
+
+	// Redirect presentation, e.g. straight into a pooled frame (same size as the current one)
+	void SetFrontBuffer(uint32_t* color_buffer);
+
+private:
+	void DrawOverlay();
+
+	template<typename Fn>
+	void DispatchFormat(Fn&& fn) const;
+
+	template<typename Format, typename Fn>
+	void DispatchLayout(Fn&& fn) const;
 
 private:
 
 	uint32_t* m_front_buffer;
-	uint32_t* m_back_buffer;
+	void* m_back_buffer;				// Points into m_back_memory
+	FramebufferMemory m_back_memory;
+	FramebufferMemoryOptions m_memory_options;
+	size_t m_back_buffer_pixels;
+	int m_tiles_x;
+	PixelFormat m_format;
+	FramebufferLayout m_layout;
 	monitor m_monitor;
 	bool m_back_buffer_init;
+	bool m_skip_frame = false;
+	bool m_front_buffer_stale = true;	// Front buffer does not hold the last presented frame
+	IRenderOverlay* m_overlay = nullptr;
+
+	// Guard band clip output for polygons too large for the stack buffer
+	std::vector<vec2_t> m_clip_vertices;
+
+	// DrawWireframe3D output, two points per surviving edge
+	std::vector<vec2_t> m_wire_points;
+	std::vector<MeshEdge> m_wire_edges;
 };
+
+template<typename Format, typename Fn>
+void Renderer::DispatchLayout(Fn&& fn) const
+{
+	typedef typename Format::pixel_t pixel_t;
+	pixel_t* pixels = static_cast<pixel_t*>(m_back_buffer);
+
+	if (m_layout == FramebufferLayout::Tiled)
+		fn(FramebufferView<Format, TiledLayout>{ pixels, m_monitor.buffer_width, m_monitor.buffer_height, m_tiles_x });
+	else
+		fn(FramebufferView<Format, LinearLayout>{ pixels, m_monitor.buffer_width, m_monitor.buffer_height, m_tiles_x });
+}
+
+// Resolve format and layout once per call, the kernels are specialized per combination
+template<typename Fn>
+void Renderer::DispatchFormat(Fn&& fn) const
+{
+	switch (m_format)
+	{
+	case PixelFormat::RGB565:
+		DispatchLayout<PixelRGB565>(fn);
+		break;
+	case PixelFormat::Indexed8:
+		DispatchLayout<PixelIndexed8>(fn);
+		break;
+	default:
+		DispatchLayout<PixelARGB8888>(fn);
+		break;
+	}
+}
+
+template<BlendMode Mode, ClipMode Clip>
+void Renderer::DrawPixel(int x, int y, uint32_t color)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::TypedPixel, Mode, Clip, x, y, color);
+
+	if (!m_back_buffer)
+		return;
+
+	DispatchFormat([=](const auto& view) { PutPixelKernel<Mode, Clip>(view, x, y, color); });
+}
+
+template<BlendMode Mode, ClipMode Clip>
+void Renderer::FillSpan(int x, int y, int length, uint32_t color)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::TypedSpan, Mode, Clip, x, y, length, color);
+
+	if (!m_back_buffer)
+		return;
+
+	DispatchFormat([=](const auto& view) { FillSpanKernel<Mode, Clip>(view, x, y, length, color); });
+}
+
+template<BlendMode Mode, ClipMode Clip>
+void Renderer::FillRect(int x, int y, int width, int height, uint32_t color)
+{
+	if (FrameCapture* capture = FrameCapture::GetActive())
+		capture->Record(CaptureRecord::TypedRect, Mode, Clip, x, y, width, height, color);
+
+	if (!m_back_buffer)
+		return;
+
+	DispatchFormat([=](const auto& view) { FillRectKernel<Mode, Clip>(view, x, y, width, height, color); });
+}
+
+template<typename Format, typename Layout>
+FramebufferView<Format, Layout> Renderer::GetView() const
+{
+	bool match = m_back_buffer && Format::format == m_format && Layout::layout == m_layout;
+	typename Format::pixel_t* pixels = match ? static_cast<typename Format::pixel_t*>(m_back_buffer) : nullptr;
+
+	return FramebufferView<Format, Layout>{ pixels, m_monitor.buffer_width, m_monitor.buffer_height, m_tiles_x };
+}
@@ -0,0 +1,64 @@
+﻿#include <algorithm>
+
+#include "text_renderer.hpp"
+
+bool TextRenderer::Initialize(int pixel_height)
+{
+	m_cache.clear();
+	return m_atlas.Build(pixel_height);
+}
+
+const ShapedText& TextRenderer::Shape(const std::string& text)
+{
+	auto cached = m_cache.find(text);
+	if (cached != m_cache.end())
+		return cached->second;
+
+	if (m_cache.size() >= m_cache_limit)
+		m_cache.clear();
+
+	ShapedText& shaped = m_cache[text];
+	shaped.glyphs.reserve(text.size());
+
+	const int line_height = m_atlas.GetLineHeight();
+	int pen_x = 0;
+	int pen_y = 0;
+
+	for (char c : text)
+	{
+		if (c == '\n')
+		{
+			pen_x = 0;
+			pen_y += line_height;
+			continue;
+		}
+
+		const GlyphInfo& glyph = m_atlas.GetGlyph(c);
+		if (glyph.width > 0)
+		{
+			AlphaMaskRect rect;
+			rect.x = pen_x + glyph.offset_x;
+			rect.y = pen_y + glyph.offset_y;
+			rect.src_x = glyph.atlas_x;
+			rect.src_y = glyph.atlas_y;
+			rect.width = glyph.width;
+			rect.height = glyph.height;
+			shaped.glyphs.push_back(rect);
+		}
+
+		pen_x += glyph.advance;
+		shaped.width = std::max(shaped.width, pen_x);
+	}
+
+	shaped.height = text.empty() ? 0 : pen_y + m_atlas.GetPixelHeight();
+	return shaped;
+}
+
+void TextRenderer::DrawString(Renderer& renderer, int x, int y, const std::string& text, uint32_t color)
+{
+	const ShapedText& shaped = Shape(text);
+	if (shaped.glyphs.empty())
+		return;
+
+	renderer.DrawAlphaMasks(x, y, m_atlas.GetPixels(), m_atlas.GetWidth(), shaped.glyphs.data(), shaped.glyphs.size(), color);
+}
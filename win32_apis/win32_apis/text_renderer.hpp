@@ -0,0 +1,58 @@
+﻿#pragma once
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glyph_atlas.hpp"
+#include "renderer.hpp"
+
+// Glyph quads of one string relative to its top left corner, ready for Renderer::DrawAlphaMasks
+struct ShapedText
+{
+	std::vector<AlphaMaskRect> glyphs;
+	int width = 0;
+	int height = 0;
+};
+
+// Draws strings from a GlyphAtlas. Layouts are cached per string, so labels that repeat every
+// frame cost one lookup and one batched mask blit
+class TextRenderer
+{
+public:
+	bool Initialize(int pixel_height);
+
+	// Cached layout of text, '\n' starts a new line. Valid until the cache starts over (ClearCache or the limit)
+	const ShapedText& Shape(const std::string& text);
+
+	// Top left corner at (x, y), color alpha is respected
+	void DrawString(Renderer& renderer, int x, int y, const std::string& text, uint32_t color);
+
+	// Same, straight into a typed view (e.g. an overlay target). Bypasses the renderer, nothing is captured
+	template<typename View>
+	void DrawString(const View& view, int x, int y, const std::string& text, uint32_t color);
+
+	int GetLineHeight() const { return m_atlas.GetLineHeight(); }
+	const GlyphAtlas& GetAtlas() const { return m_atlas; }
+
+	void ClearCache() { m_cache.clear(); }
+
+	// Strings kept before the cache starts over, changing labels (counters, timers) would grow it forever
+	void SetCacheLimit(size_t limit) { m_cache_limit = limit; }
+
+private:
+	GlyphAtlas m_atlas;
+
+	std::unordered_map<std::string, ShapedText> m_cache;
+	size_t m_cache_limit = 4096;
+};
+
+template<typename View>
+void TextRenderer::DrawString(const View& view, int x, int y, const std::string& text, uint32_t color)
+{
+	const ShapedText& shaped = Shape(text);
+	if (shaped.glyphs.empty() || !view.pixels || ((color >> 24) & 0xFF) == 0)
+		return;
+
+	BlendAlphaMasksKernel(view, x, y, m_atlas.GetPixels(), m_atlas.GetWidth(), shaped.glyphs.data(), shaped.glyphs.size(), color);
+}
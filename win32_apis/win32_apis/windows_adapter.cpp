@@ -342,15 +342,19 @@ void WindowsAdapter::StartWindowed(int x, int y, unsigned int w, unsigned int h,
 			m_time = time;
 			float aspect = m_buffer_width / (float)m_buffer_height;
 
-			m_application->Update(dt);
-			m_application->Render(aspect);
+			m_application->RunFrame(dt, aspect);
 
+			bool presented = true;
 			if (m_application->GetRenderer())
-				m_application->GetRenderer()->SwapBuffers();
+				presented = m_application->GetRenderer()->SwapBuffers();
 
-			if (m_hdc)
+			if (m_hdc && presented)
 				PresentPixelBuffer(m_hdc);
 
+			// Unchanged frame, idle until input arrives or the next tick instead of spinning
+			if (!presented)
+				MsgWaitForMultipleObjects(0, nullptr, FALSE, 1, QS_ALLINPUT);
+
 		}
 	}
 
@@ -414,6 +418,9 @@ LRESULT CALLBACK WindowsAdapter::WinProc(HWND hWnd, UINT message, WPARAM wParam,
 				break;
 			}
 
+			if (adapter->m_application)
+				adapter->m_application->KeyDown(static_cast<int>(wParam));
+
 			// Trigger repaint to show changes
 			InvalidateRect(hWnd, nullptr, FALSE);
 			break;